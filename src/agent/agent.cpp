@@ -1,84 +1,172 @@
 #include "agent.h"
 using namespace std;
 
-Agent::Agent() {
+Agent::Agent()
+    : mSearchResultCache(DEFAULT_SEARCH_CACHE_BYTES), mTrapdoorCache(DEFAULT_TRAPDOOR_CACHE_BYTES) {
     mNumContract = 0;
+    mIndexedHeight = 0;
+    mLocks.reset(new AgentLocks);
+    mHttpThreads = 1;
+    mComputeThreads = thread::hardware_concurrency();
+    mNextTransactionID = 0;
+    mIngestQueueDepth = DEFAULT_INGEST_QUEUE_DEPTH;
+    mHashFormat = PEKS_HASH_BINARY;
+    mSearchIndex = SEARCH_INDEX_PEKS;
+    peks_curve_init(&mCurve, "A", 0, 0);
 }
 
-Agent::Agent(string agent_info_path, string contract_root_dir) {
-    //check if keys already exist
-    init_pbc_param_pairing(mParam, mPairing);
-    double P = mpz_get_d(mPairing->r);
-    KeyGen(&mKey, mParam, mPairing);
+Agent::Agent(string agent_info_path, string contract_root_dir, bool gen_params)
+    : mSearchResultCache(DEFAULT_SEARCH_CACHE_BYTES), mTrapdoorCache(DEFAULT_TRAPDOOR_CACHE_BYTES) {
     mNumContract = 0;
+    mIndexedHeight = 0;
+    mLocks.reset(new AgentLocks);
+    mHttpThreads = 1;
+    mComputeThreads = thread::hardware_concurrency();
+    mNextTransactionID = 0;
+    mIngestQueueDepth = DEFAULT_INGEST_QUEUE_DEPTH;
+    mHashFormat = PEKS_HASH_BINARY;
+    mSearchIndex = SEARCH_INDEX_PEKS;
+    peks_curve_init(&mCurve, "A", 0, 0);
     this->Load_Agent_Info(agent_info_path);
     Set_Contract_Root(contract_root_dir);
+    if (mParamPath == "") {
+        mParamPath = agent_info_path.substr(0, agent_info_path.find_last_of('/') + 1) + "pairing.param";
+    }
+    if (mKeyPath == "") {
+        mKeyPath = agent_info_path.substr(0, agent_info_path.find_last_of('/') + 1) + "agent.key";
+    }
+    __load_param(gen_params);
+    // keys made on other parameters are useless, so regenerate them too
+    if (gen_params || !__load_key(mKeyPath)) {
+        mKey.Generate(mPairing);
+        __save_key(mKeyPath);
+    }
+    if (mTrapdoorIndexPath == "") {
+        mTrapdoorIndexPath = agent_info_path.substr(0, agent_info_path.find_last_of('/') + 1) + "trapdoor.index";
+    }
+    if (mSearchIndex == SEARCH_INDEX_TOKEN) {
+        __derive_token_key();
+    }
+    else {
+        __load_encryptedcontract();
+    }
     __load_contract();
 }
 
+void Agent::__load_param(bool gen_params) {
+    int err = mPairing.LoadOrGenerate(mParamPath, gen_params, &mCurve);
+    if (err == -1) {
+        cout << "Fail to load pairing parameters from " << mParamPath
+             << ", run with --gen-params to generate new ones" << endl;
+        exit(EXIT_FAILURE);
+    }
+    else if (err == -2) {
+        cout << "Fail to save pairing parameters to " << mParamPath << endl;
+    }
+    pbc_param_hash(mPairing.param(), mParamHash);
+    mTrapdoorVocabulary.setElementSize(pairing_length_in_bytes_G1(mPairing));
+}
+
+// Key file layout, integers in host byte order:
+//   magic "NCKY" | uint32 version | SHA-256 of the pairing parameters
+//   | (uint32 length, element_to_bytes) for priv, g and h
+//   | SHA-256 over everything before it
+#define KEY_FILE_MAGIC "NCKY"
+#define KEY_FILE_VERSION 1
+
+static void __append_element(string &buffer, element_ptr e) {
+    uint32_t len = element_length_in_bytes(e);
+    vector<unsigned char> data(len);
+    element_to_bytes(data.data(), e);
+    buffer.append((char*)&len, sizeof(len));
+    buffer.append((char*)data.data(), len);
+}
+
+static bool __read_element(const string &buffer, size_t &offset, element_ptr e) {
+    uint32_t len;
+    if (offset + sizeof(len) > buffer.size()) {
+        return false;
+    }
+    memcpy(&len, buffer.data() + offset, sizeof(len));
+    offset += sizeof(len);
+    if (len != (uint32_t)element_length_in_bytes(e) || offset + len > buffer.size()) {
+        return false;
+    }
+    element_from_bytes(e, (unsigned char*)buffer.data() + offset);
+    offset += len;
+    return true;
+}
+
 void Agent::__save_key(string key_file_path) {
+    uint32_t version = KEY_FILE_VERSION;
+    string key_bytes(KEY_FILE_MAGIC, 4);
+    key_bytes.append((char*)&version, sizeof(version));
+    key_bytes.append((char*)mParamHash, SHA256_DIGEST_LENGTH);
+    __append_element(key_bytes, mKey.priv());
+    __append_element(key_bytes, mKey.pub()->g);
+    __append_element(key_bytes, mKey.pub()->h);
+
+    unsigned char checksum[SHA256_DIGEST_LENGTH];
+    SHA256((unsigned char*)key_bytes.data(), key_bytes.size(), checksum);
+    key_bytes.append((char*)checksum, SHA256_DIGEST_LENGTH);
 
-    KeyGen(&mKey, mParam, mPairing);
-
-    vector<string> key_str;
-    //save private key
-    int priv_len = element_length_in_bytes(mKey.priv);
-    unsigned char private_c[priv_len];
-    element_to_bytes(private_c, mKey.priv);
-    string priv_str((char*)private_c);
-    key_str.push_back(priv_str);
-
-    //save g
-    int g_len = element_length_in_bytes(mKey.pub.g);
-    unsigned char g_c[g_len];
-    element_to_bytes(g_c, mKey.pub.g);
-    string g_str((char*)g_c);
-    key_str.push_back(g_str);
-
-    //save h
-    int h_len = element_length_in_bytes(mKey.pub.h);
-    unsigned char h_c[h_len];
-    element_to_bytes(h_c, mKey.pub.h);
-    string h_str((char*)h_c);
-    key_str.push_back(h_str);
-
-    //save key to key file
-    stringstream archive_stream;
-    boost::archive::text_oarchive archive(archive_stream);
-    archive << key_str;
-    ofstream key_out_file(key_file_path);
-    key_out_file << archive_stream.str();
+    // write to a temporary file first so a crash never leaves a truncated key
+    string tmp_path = key_file_path + ".tmp";
+    ofstream key_out_file(tmp_path, ios::binary | ios::trunc);
+    key_out_file.write(key_bytes.data(), key_bytes.size());
     key_out_file.close();
+    if (!key_out_file || rename(tmp_path.c_str(), key_file_path.c_str()) != 0) {
+        cout << "Fail to save key to " << key_file_path << endl;
+    }
 }
 
-void Agent::__load_key(string key_file_path) {
-    vector<string> key_str;
-
-    std::ifstream ifs(key_file_path);
-    std::string key_content( (std::istreambuf_iterator<char>(ifs) ),
+bool Agent::__load_key(string key_file_path) {
+    std::ifstream ifs(key_file_path, ios::binary);
+    if (!ifs.is_open()) {
+        return false;
+    }
+    std::string key_bytes( (std::istreambuf_iterator<char>(ifs) ),
                            (std::istreambuf_iterator<char>()) );
     ifs.close();
 
-    stringstream iarchive_stream;
-    iarchive_stream << key_content;
-    boost::archive::text_iarchive iarchive(iarchive_stream);
-    iarchive >> key_str;
+    size_t header_len = 4 + sizeof(uint32_t) + SHA256_DIGEST_LENGTH;
+    if (key_bytes.size() < header_len + SHA256_DIGEST_LENGTH
+            || key_bytes.compare(0, 4, KEY_FILE_MAGIC) != 0) {
+        cout << "Key file " << key_file_path << " is not a key file" << endl;
+        exit(EXIT_FAILURE);
+    }
 
-    element_t key_priv;
-    element_init_G1(key_priv, mPairing);
-    element_from_bytes(key_priv, (unsigned char*) key_str[0].c_str());
+    size_t payload_len = key_bytes.size() - SHA256_DIGEST_LENGTH;
+    unsigned char checksum[SHA256_DIGEST_LENGTH];
+    SHA256((unsigned char*)key_bytes.data(), payload_len, checksum);
+    if (memcmp(checksum, key_bytes.data() + payload_len, SHA256_DIGEST_LENGTH) != 0) {
+        cout << "Key file " << key_file_path << " is corrupted" << endl;
+        exit(EXIT_FAILURE);
+    }
 
-    element_t g;
-    element_init_G1(g, mPairing);
-    element_from_bytes(g, (unsigned char*) key_str[1].c_str());
+    uint32_t version;
+    memcpy(&version, key_bytes.data() + 4, sizeof(version));
+    if (version != KEY_FILE_VERSION) {
+        cout << "Key file " << key_file_path << " has unknown version " << version << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (memcmp(mParamHash, key_bytes.data() + 4 + sizeof(version), SHA256_DIGEST_LENGTH) != 0) {
+        cout << "Key file " << key_file_path << " belongs to other pairing parameters" << endl;
+        exit(EXIT_FAILURE);
+    }
 
-    element_t h;
-    element_init_G1(h, mPairing);
-    element_from_bytes(h, (unsigned char*) key_str[2].c_str());
+    mKey.Init(mPairing);
 
-    element_init_same_as(mKey.priv, key_priv);
-    element_init_same_as(mKey.pub.g, g);
-    element_init_same_as(mKey.pub.h, h);
+    size_t offset = header_len;
+    if (!__read_element(key_bytes, offset, mKey.priv())
+            || !__read_element(key_bytes, offset, mKey.pub()->g)
+            || !__read_element(key_bytes, offset, mKey.pub()->h)
+            || offset != payload_len) {
+        cout << "Key file " << key_file_path << " does not match the pairing parameters" << endl;
+        exit(EXIT_FAILURE);
+    }
+    mKey.Precompute();
+    return true;
 }
 
 void Agent::Load_Agent_Info(string path) {
@@ -90,14 +178,58 @@ void Agent::Load_Agent_Info(string path) {
         mAddr = agent_map["ADDR"];
         mIPAddr = agent_map["IP_ADDR"];
         mOpenPort = agent_map["OPENPORT"];
+        mParamPath = agent_map["PARAM_FILE"];
+        mKeyPath = agent_map["KEY_FILE"];
+        mTrapdoorIndexPath = agent_map["TRAPDOOR_INDEX_FILE"];
+        if (agent_map["CURVE"] != "") {
+            int rbits = agent_map["CURVE_RBITS"] != "" ? stoi(agent_map["CURVE_RBITS"]) : 0;
+            int qbits = agent_map["CURVE_QBITS"] != "" ? stoi(agent_map["CURVE_QBITS"]) : 0;
+            if (peks_curve_init(&mCurve, agent_map["CURVE"].c_str(), rbits, qbits) != 0) {
+                cout << "Unknown CURVE " << agent_map["CURVE"] << ", use A, A1, E or F" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (agent_map["SEARCH_INDEX"] == "token") {
+            mSearchIndex = SEARCH_INDEX_TOKEN;
+        }
+        else if (agent_map["SEARCH_INDEX"] != "" && agent_map["SEARCH_INDEX"] != "peks") {
+            cout << "Unknown SEARCH_INDEX " << agent_map["SEARCH_INDEX"] << ", use peks or token" << endl;
+            exit(EXIT_FAILURE);
+        }
+        // the pool has to be in place before the pairing allocates anything
+        if (agent_map["PBC_POOL"] == "1") {
+            pbc_pool_install();
+        }
+        if (agent_map["TRAPDOOR_CACHE_BYTES"] != "") {
+            mTrapdoorCache.setCapacity(stoull(agent_map["TRAPDOOR_CACHE_BYTES"]));
+        }
+        if (agent_map["SEARCH_CACHE_BYTES"] != "") {
+            mSearchResultCache.setCapacity(stoull(agent_map["SEARCH_CACHE_BYTES"]));
+        }
+        if (agent_map["HTTP_THREADS"] != "") {
+            mHttpThreads = max(1UL, stoul(agent_map["HTTP_THREADS"]));
+        }
+        if (agent_map["INGEST_QUEUE_DEPTH"] != "") {
+            mIngestQueueDepth = stoul(agent_map["INGEST_QUEUE_DEPTH"]);
+        }
+        if (agent_map["COMPUTE_THREADS"] != "") {
+            mComputeThreads = stoul(agent_map["COMPUTE_THREADS"]);
+        }
+        if (agent_map["SEARCH_THREADS"] != "") {
+            mSearchExecutor.setNumThreads(stoul(agent_map["SEARCH_THREADS"]));
+        }
+        else {
+            mSearchExecutor.setNumThreads(thread::hardware_concurrency());
+        }
     }
     else {
         cout << "Parsing Approver Info fails!" << endl;
     }
 }
 
-void Agent::__encrypt_contract(Contract contract) {
-    contract.setTransactionID((uint64_t)mContractList.size());
+// The searchable words of a contract: transaction id, buyer addr, seller
+// addr, price, product and every word of the description
+vector<string> Agent::__contract_words(Contract contract) {
     uint64_t Transaction_ID = contract.getTransactionID();
     string buyer_addr = contract.getBuyerAddr();
     string seller_addr = contract.getSellerAddr();
@@ -106,11 +238,6 @@ void Agent::__encrypt_contract(Contract contract) {
     string description = contract.getDescription();
     vector<string> description_words;
 
-    vector<element_s> trapdoor_list;
-    description_words.clear();
-    vector<vector<unsigned char>> contract_trapdoor_list;
-    contract_trapdoor_list.clear();
-
     // parse desription based on
     std::stringstream description_ss(description);
     string one_word_description;
@@ -120,314 +247,1117 @@ void Agent::__encrypt_contract(Contract contract) {
         description_words.push_back(one_word_description);
     }
 
-    // encrypt transaction id
-    {
-        char *hashedW = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-        element_t Tw;    // trapdoor word
-        element_t H1_W1;
-        string Transaction_ID_str = std::to_string(Transaction_ID);
-        char* Transaction_ID_c = (char*) Transaction_ID_str.c_str();
-        sha512(Transaction_ID_c, (int)strlen(Transaction_ID_c), hashedW);
-        element_init_G1(H1_W1, mPairing);
-        element_from_hash(H1_W1, hashedW, (int)strlen(hashedW));
-        Trapdoor(Tw, mPairing, mKey.priv, H1_W1);
-        free(hashedW);
-        hashedW = NULL;
-        element_s tmp = {Tw->field, Tw->data};
-        trapdoor_list.push_back(tmp);
-
-        int len = element_length_in_bytes(Tw);
-        unsigned char data_tmp[len];
-        element_to_bytes(data_tmp, Tw);
-        vector<unsigned char> data_vec_tmp(data_tmp, data_tmp + len);
-        contract_trapdoor_list.push_back(data_vec_tmp);
-    }
-
-
-    // encrypt buyer addr
-    {
-        char *hashedW = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-        element_t Tw;    // trapdoor word
-        element_t H1_W1;
-        char* buyer_addr_c = (char*) buyer_addr.c_str();
-        sha512(buyer_addr_c, (int)strlen(buyer_addr_c), hashedW);
-        element_init_G1(H1_W1, mPairing);
-        element_from_hash(H1_W1, hashedW, (int)strlen(hashedW));
-        Trapdoor(Tw, mPairing, mKey.priv, H1_W1);
-        free(hashedW);
-        hashedW = NULL;
-        element_s tmp = {Tw->field, Tw->data};
-        trapdoor_list.push_back(tmp);
-
-        int len = element_length_in_bytes(Tw);
-        unsigned char data_tmp[len];
-        element_to_bytes(data_tmp, Tw);
-        vector<unsigned char> data_vec_tmp(data_tmp, data_tmp + len);
-        contract_trapdoor_list.push_back(data_vec_tmp);
-    }
-
-    // encrypt seller addr
-    {
-        char *hashedW = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-        element_t Tw;    // trapdoor word
-        element_t H1_W1;
-        char* seller_addr_c = (char*) seller_addr.c_str();
-        sha512(seller_addr_c, (int)strlen(seller_addr_c), hashedW);
-        element_init_G1(H1_W1, mPairing);
-        element_from_hash(H1_W1, hashedW, (int)strlen(hashedW));
-        Trapdoor(Tw, mPairing, mKey.priv, H1_W1);
-        free(hashedW);
-        hashedW = NULL;
-        element_s tmp = {Tw->field, Tw->data};
-        trapdoor_list.push_back(tmp);
-
-        int len = element_length_in_bytes(Tw);
-        unsigned char data_tmp[len];
-        element_to_bytes(data_tmp, Tw);
-        vector<unsigned char> data_vec_tmp(data_tmp, data_tmp + len);
-        contract_trapdoor_list.push_back(data_vec_tmp);
-    }
-
-
-    // encrypt product
-    {
-        char *hashedW = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-        element_t Tw;    // trapdoor word
-        element_t H1_W1;
-        string price_str = std::to_string(price);
-        char* price_c = (char*) price_str.c_str();
-        sha512(price_c, (int)strlen(price_c), hashedW);
-        element_init_G1(H1_W1, mPairing);
-        element_from_hash(H1_W1, hashedW, (int)strlen(hashedW));
-        Trapdoor(Tw, mPairing, mKey.priv, H1_W1);
-        free(hashedW);
-        hashedW = NULL;
-        element_s tmp = {Tw->field, Tw->data};
-        trapdoor_list.push_back(tmp);
-
-        int len = element_length_in_bytes(Tw);
-        unsigned char data_tmp[len];
-        element_to_bytes(data_tmp, Tw);
-        vector<unsigned char> data_vec_tmp(data_tmp, data_tmp + len);
-        contract_trapdoor_list.push_back(data_vec_tmp);
-    }
-
-    // encrypt price
-    {
-        char *hashedW = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-        element_t Tw;    // trapdoor word
-        element_t H1_W1;
-        char* product_char = (char*) product.c_str();
-        sha512(product_char, (int)strlen(product_char), hashedW);
-        element_init_G1(H1_W1, mPairing);
-        element_from_hash(H1_W1, hashedW, (int)strlen(hashedW));
-        Trapdoor(Tw, mPairing, mKey.priv, H1_W1);
-        free(hashedW);
-        hashedW = NULL;
-        element_s tmp = {Tw->field, Tw->data};
-        trapdoor_list.push_back(tmp);
-
-        int len = element_length_in_bytes(Tw);
-        unsigned char data_tmp[len];
-        element_to_bytes(data_tmp, Tw);
-        vector<unsigned char> data_vec_tmp(data_tmp, data_tmp + len);
-        contract_trapdoor_list.push_back(data_vec_tmp);
-    }
-
-    // encrypt description
-    {
-        for (int i = 0; i < description_words.size(); i++) {
-            char *hashedW = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-            element_t Tw;    // trapdoor word
-            element_t H1_W1;
-            char* description_word = (char*) description_words[i].c_str();
-            sha512(description_word, (int)strlen(description_word), hashedW);
-            element_init_G1(H1_W1, mPairing);
-            element_from_hash(H1_W1, hashedW, (int)strlen(hashedW));
-            Trapdoor(Tw, mPairing, mKey.priv, H1_W1);
-            free(hashedW);
-            hashedW = NULL;
-            element_s tmp = {Tw->field, Tw->data};
-            trapdoor_list.push_back(tmp);
+    vector<string> words;
+    words.push_back(std::to_string(Transaction_ID));
+    words.push_back(buyer_addr);
+    words.push_back(seller_addr);
+    words.push_back(std::to_string(price));
+    words.push_back(product);
+    words.insert(words.end(), description_words.begin(), description_words.end());
+    return words;
+}
+
+int Agent::__word_field(size_t word_index) {
+    return word_index < FIELD_DESCRIPTION ? (int)word_index : FIELD_DESCRIPTION;
+}
 
-            int len = element_length_in_bytes(Tw);
-            unsigned char data_tmp[len];
-            element_to_bytes(data_tmp, Tw);
-            vector<unsigned char> data_vec_tmp(data_tmp, data_tmp + len);
-            contract_trapdoor_list.push_back(data_vec_tmp);
+// field of a search request, FIELD_ANY if none is given
+int Agent::__parse_field(string field_name) {
+    const char *names[NUM_FIELDS] = {"txid", "buyer", "seller", "price", "product", "description"};
+    if (field_name == "") {
+        return FIELD_ANY;
+    }
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        if (field_name == names[i]) {
+            return i;
         }
     }
+    return FIELD_UNKNOWN;
+}
 
-    this->mContract2TrapdoorMap.insert(pair<uint64_t, vector<element_s>>(contract.getTransactionID(), trapdoor_list));
-//    __save_encryptedcontract(contract_trapdoor_list);
+// a field name a query term may be scoped to
+bool Agent::__is_field(const string &field_name) {
+    return __parse_field(field_name) >= 0;
 }
 
-void Agent::__save_encryptedcontract(vector<vector<unsigned char>> trapdoor_list) {
-	stringstream archive_stream;
-	boost::archive::text_oarchive archive(archive_stream);
-	archive << trapdoor_list;
-    ofstream contract_out_file(mContractRootDir + "/contract" + to_string(mContractList.size()) + ".peksct");
-	contract_out_file << archive_stream.str();
-	contract_out_file.close();
+void Agent::__encrypt_contract(Contract contract) {
+    __encrypt_contracts(vector<Contract>(1, contract));
 }
 
-void Agent::__load_encryptedcontract() {
-    DIR *dir;
-    struct dirent *ent;
-    if ((dir = opendir (mContractRootDir.c_str())) != NULL) {
-        while ((ent = readdir (dir)) != NULL) {
-            string contract_file_name(ent->d_name);
-            if (contract_file_name == "." || contract_file_name == "..") {
-                continue;
+// Encrypts contracts in ascending transaction id order
+void Agent::__encrypt_contracts(vector<Contract> contracts) {
+    vector<vector<vector<unsigned char>>> trapdoor_lists = __make_trapdoors(contracts);
+    __index_trapdoors(contracts, trapdoor_lists);
+}
+
+// The trapdoors of every word of the contracts, in __contract_words order.
+// Only words not seen recently are exponentiated, each distinct one once,
+// in parallel on the search pool.
+vector<vector<vector<unsigned char>>> Agent::__make_trapdoors(vector<Contract> &contracts) {
+    vector<vector<string>> contract_digests(contracts.size());
+    vector<vector<vector<unsigned char>>> trapdoor_lists(contracts.size());
+    vector<string> missing;
+    unordered_map<string, uint64_t> missing_slots;
+    for (int i = 0; i < contracts.size(); i++) {
+        vector<string> words = __contract_words(contracts[i]);
+        for (int j = 0; j < words.size(); j++) {
+            unsigned char hashedW[SHA512_DIGEST_LENGTH];
+            sha512_raw(words[j].c_str(), (int)words[j].length(), hashedW);
+            string digest((char*)hashedW, SHA512_DIGEST_LENGTH);
+
+            // left empty until the missing trapdoors are made
+            vector<unsigned char> data_vec_tmp;
+            if (missing_slots.find(digest) == missing_slots.end()
+                    && !mTrapdoorCache.Get(digest, data_vec_tmp)) {
+                missing_slots.insert(pair<string, uint64_t>(digest, missing.size()));
+                missing.push_back(digest);
             }
-            string full_path = mContractRootDir + "/" + contract_file_name;
-            std::ifstream ifs(full_path);
-            std::string contract_content( (std::istreambuf_iterator<char>(ifs) ),
-                                   (std::istreambuf_iterator<char>()    ) );
-            ifs.close();
-
-            stringstream iarchive_stream;
-            iarchive_stream << contract_content;
-            boost::archive::text_iarchive iarchive(iarchive_stream);
-            vector<vector<unsigned char>> encrypted_contract;
-            iarchive >> encrypted_contract;
-
-            vector<element_s> tmp_vec;
-            for(int i=0; i<encrypted_contract.size(); i++) {
-                element_t tmp_et;
-                element_init_G1(tmp_et, mPairing);
-                int len = element_length_in_bytes(tmp_et);
-                element_from_bytes(tmp_et, encrypted_contract[i].data());
-                element_s tmp_es = {tmp_et->field, tmp_et->data};
-                tmp_vec.push_back(tmp_es);
+            contract_digests[i].push_back(digest);
+            trapdoor_lists[i].push_back(data_vec_tmp);
+        }
+    }
+
+    vector<vector<unsigned char>> made(missing.size());
+    mSearchExecutor.ParallelFor(0, missing.size(), 1, [&](uint64_t lo, uint64_t hi) {
+        for (uint64_t k = lo; k < hi; k++) {
+            Element Tw;    // trapdoor word
+            Element H1_W1;
+            H1(H1_W1, mPairing, (const unsigned char*)missing[k].data(), mHashFormat);
+            Trapdoor(Tw, mPairing, mKey.priv(), H1_W1);
+            made[k] = Tw.toBytes();
+        }
+    });
+    for (int k = 0; k < missing.size(); k++) {
+        mTrapdoorCache.Put(missing[k], made[k]);
+    }
+    for (int i = 0; i < contracts.size(); i++) {
+        for (int j = 0; j < trapdoor_lists[i].size(); j++) {
+            if (trapdoor_lists[i][j].empty()) {
+                trapdoor_lists[i][j] = made[missing_slots[contract_digests[i][j]]];
             }
+        }
+    }
+    return trapdoor_lists;
+}
 
-            this->mContract2TrapdoorMap.insert(pair<uint64_t, vector<element_s>>((uint64_t)mContractList.size(), tmp_vec));
+// Publishes the trapdoors of contracts to searches, all trapdoors of a
+// contract or none of them, and appends them to the index file, those of
+// consecutive contracts in one append
+void Agent::__index_trapdoors(vector<Contract> &contracts,
+                              vector<vector<vector<unsigned char>>> &trapdoor_lists) {
+    {
+        boost::unique_lock<boost::shared_mutex> lock(mLocks->index);
+        for (int i = 0; i < contracts.size(); i++) {
+            for (int j = 0; j < trapdoor_lists[i].size(); j++) {
+                __index_trapdoor(contracts[i].getTransactionID(), trapdoor_lists[i][j], __word_field(j));
+            }
+        }
+    }
+    __save_encryptedcontracts(contracts, trapdoor_lists);
+}
+
+void Agent::__tokenize_contract(Contract contract) {
+    uint64_t Transaction_ID = contract.getTransactionID();
+    vector<string> words = __contract_words(contract);
+    boost::unique_lock<boost::shared_mutex> lock(mLocks->index);
+    for (int i = 0; i < words.size(); i++) {
+        mTokenIndex.Add(Transaction_ID, words[i], __word_field(i));
+    }
+    mIndexedHeight = max(mIndexedHeight, Transaction_ID + 1);
+}
 
+void Agent::__index_contract(Contract contract) {
+    __index_contracts(vector<Contract>(1, contract));
+}
+
+void Agent::__index_contracts(vector<Contract> contracts) {
+    if (mSearchIndex == SEARCH_INDEX_TOKEN) {
+        for (int i = 0; i < contracts.size(); i++) {
+            __tokenize_contract(contracts[i]);
         }
-        closedir (dir);
     }
     else {
-        perror ("Fail to open contract directory");
+        __encrypt_contracts(contracts);
     }
 }
 
-void Agent::__save_contract(Contract contract) {
+// The token key is SHA-256 over a label and α, so it is as secret as α
+// and changes whenever the agent key does.
+#define TOKEN_KEY_LABEL "NormaChain token index"
+
+void Agent::__derive_token_key() {
+    string key_bytes(TOKEN_KEY_LABEL);
+    __append_element(key_bytes, mKey.priv());
+    unsigned char token_key[SHA256_DIGEST_LENGTH];
+    SHA256((unsigned char*)key_bytes.data(), key_bytes.size(), token_key);
+    mTokenIndex.setKey(token_key);
+    memset(&key_bytes[0], 0, key_bytes.size());
+}
+
+// Adds one trapdoor of a transaction to the vocabulary and to the column
+// of its field. Trapdoors are deterministic, so a word seen before maps
+// to the same entry and only gets the transaction appended to its posting
+// lists. Called with the index lock held exclusively.
+void Agent::__index_trapdoor(uint64_t transaction_id, const vector<unsigned char> &trapdoor_bytes,
+                             int field) {
+    mIndexedHeight = max(mIndexedHeight, transaction_id + 1);
+    string key((const char*)trapdoor_bytes.data(), trapdoor_bytes.size());
+    uint64_t vocabulary_id;
+    unordered_map<string, uint64_t>::iterator it = mTrapdoor2VocabularyMap.find(key);
+    if (it == mTrapdoor2VocabularyMap.end()) {
+        vocabulary_id = mTrapdoorVocabulary.Append(trapdoor_bytes.data());
+        mTrapdoorPostings.push_back(vector<uint64_t>(1, transaction_id));
+        mTrapdoor2VocabularyMap.insert(pair<string, uint64_t>(key, vocabulary_id));
+    }
+    else {
+        vocabulary_id = it->second;
+        vector<uint64_t> &postings = mTrapdoorPostings[vocabulary_id];
+        if (postings.back() != transaction_id) {
+            postings.push_back(transaction_id);
+        }
+    }
+
+    if (mTransactionTrapdoors.size() <= transaction_id) {
+        mTransactionTrapdoors.resize(transaction_id + 1);
+    }
+    mTransactionTrapdoors[transaction_id].push_back(vocabulary_id);
+
+    TrapdoorColumn &column = mFieldColumns[field];
+    unordered_map<uint64_t, uint64_t>::iterator column_it = column.positions.find(vocabulary_id);
+    if (column_it == column.positions.end()) {
+        column.positions.insert(pair<uint64_t, uint64_t>(vocabulary_id, column.vocabulary.size()));
+        column.vocabulary.push_back(vocabulary_id);
+        column.postings.push_back(vector<uint64_t>(1, transaction_id));
+        return;
+    }
+    vector<uint64_t> &postings = column.postings[column_it->second];
+    if (postings.back() != transaction_id) {
+        postings.push_back(transaction_id);
+    }
+}
+
+// one append per run of consecutive transaction ids
+void Agent::__save_encryptedcontracts(vector<Contract> &contracts,
+                                      const vector<vector<vector<unsigned char>>> &trapdoor_lists) {
+    size_t begin = 0;
+    while (begin < contracts.size()) {
+        uint64_t first_id = contracts[begin].getTransactionID();
+        size_t end = begin + 1;
+        while (end < contracts.size() && contracts[end].getTransactionID() == first_id + end - begin) {
+            end++;
+        }
+        if (!mTrapdoorIndex.AppendBatch(first_id, trapdoor_lists.data() + begin, end - begin)) {
+            cout << "Fail to save trapdoors of transactions " << first_id << " to "
+                 << first_id + end - begin - 1 << " to " << mTrapdoorIndexPath << endl;
+        }
+        begin = end;
+    }
+}
+
+void Agent::__load_encryptedcontract() {
+    // the index is only valid for the parameters and key it was made with
+    unsigned char key_id[SHA256_DIGEST_LENGTH];
+    int h_len = element_length_in_bytes(mKey.pub()->h);
+    vector<unsigned char> h_bytes(h_len);
+    element_to_bytes(h_bytes.data(), mKey.pub()->h);
+    SHA256(h_bytes.data(), h_len, key_id);
+
+    bool usable = mTrapdoorIndex.Open(mTrapdoorIndexPath, mParamHash, key_id);
+    if (usable) {
+        // keep making trapdoors the way the stored ones were made
+        uint32_t flags = mTrapdoorIndex.getFlags();
+        mHashFormat = (flags & TRAPDOOR_INDEX_FLAG_BINARY_H1) ? PEKS_HASH_BINARY : PEKS_HASH_HEX;
+        bool compressed = (flags & TRAPDOOR_INDEX_FLAG_COMPRESSED_G1) != 0;
+        uint32_t element_size = compressed ? pairing_length_in_bytes_compressed_G1(mPairing)
+                                           : pairing_length_in_bytes_G1(mPairing);
+        if (mTrapdoorIndex.getElementSize() != element_size) {
+            mTrapdoorIndex.Close();
+            usable = false;
+        }
+        else if (compressed) {
+            usable = __decompress_index(key_id);
+        }
+    }
+    if (!usable) {
+        cout << "No usable trapdoor index at " << mTrapdoorIndexPath
+             << ", contracts will be encrypted again" << endl;
+        mHashFormat = PEKS_HASH_BINARY;
+        if (!mTrapdoorIndex.Create(mTrapdoorIndexPath, mParamHash, key_id,
+                                   pairing_length_in_bytes_G1(mPairing), TRAPDOOR_INDEX_FLAG_BINARY_H1)) {
+            perror ("Fail to create trapdoor index");
+        }
+        return;
+    }
+
+    uint32_t element_size = mTrapdoorIndex.getElementSize();
+    boost::unique_lock<boost::shared_mutex> lock(mLocks->index);
+    for (uint64_t Transaction_ID = 0; Transaction_ID < mTrapdoorIndex.getCount(); Transaction_ID++) {
+        uint64_t num_trapdoors;
+        const unsigned char *trapdoors = mTrapdoorIndex.getTrapdoors(Transaction_ID, num_trapdoors);
+        if (num_trapdoors == 0) {
+            continue;
+        }
+        for (uint64_t i = 0; i < num_trapdoors; i++) {
+            const unsigned char *trapdoor = trapdoors + i * element_size;
+            vector<unsigned char> trapdoor_bytes(trapdoor, trapdoor + element_size);
+            // trapdoors are stored in the order of __contract_words
+            __index_trapdoor(Transaction_ID, trapdoor_bytes, __word_field(i));
+        }
+    }
+}
+
+// Rewrites an index of compressed points with the full encoding, which
+// the vocabulary needs anyway, so the square root of decompressing a
+// point is paid once and not on every start. Transactions the rewrite
+// does not get to are past getCount() and encrypted again.
+bool Agent::__decompress_index(const unsigned char *key_id) {
+    uint64_t count = mTrapdoorIndex.getCount();
+    uint32_t compressed_size = mTrapdoorIndex.getElementSize();
+    vector<vector<vector<unsigned char>>> trapdoor_lists(count);
+    Element Tw;
+    Tw.initG1(mPairing);
+    for (uint64_t Transaction_ID = 0; Transaction_ID < count; Transaction_ID++) {
+        uint64_t num_trapdoors;
+        const unsigned char *trapdoors = mTrapdoorIndex.getTrapdoors(Transaction_ID, num_trapdoors);
+        for (uint64_t i = 0; i < num_trapdoors; i++) {
+            Tw.fromBytesCompressed(trapdoors + i * compressed_size);
+            trapdoor_lists[Transaction_ID].push_back(Tw.toBytes());
+        }
+    }
+
+    uint32_t flags = mTrapdoorIndex.getFlags() & ~TRAPDOOR_INDEX_FLAG_COMPRESSED_G1;
+    if (!mTrapdoorIndex.Create(mTrapdoorIndexPath, mParamHash, key_id,
+                               pairing_length_in_bytes_G1(mPairing), flags)) {
+        return false;
+    }
+    if (count > 0 && !mTrapdoorIndex.AppendBatch(0, trapdoor_lists.data(), count)) {
+        cout << "Fail to rewrite the trapdoor index at " << mTrapdoorIndexPath << endl;
+    }
+    return true;
+}
+
+// The contract file is the durable record of a transaction, so it is on
+// disk before the contract is acknowledged
+bool Agent::__save_contract(Contract contract) {
     string file_content = contract.genContractFileStr();
-    std::ofstream out(mContractRootDir + "/contract" + to_string(mContractList.size()) + ".ct");
-    out << file_content;
-    out.close();
+    string path = __contract_path(contract.getTransactionID());
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool saved = write(fd, file_content.data(), file_content.size()) == (ssize_t)file_content.size()
+                 && fsync(fd) == 0;
+    close(fd);
+    if (!saved) {
+        unlink(path.c_str());
+    }
+    return saved;
+}
+
+string Agent::__contract_path(uint64_t transaction_id) {
+    return mContractRootDir + "/contract" + to_string(transaction_id + 1) + ".ct";
+}
+
+// makes the names of newly created contract files durable
+bool Agent::__sync_contract_dir() {
+    int fd = open(mContractRootDir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+static bool __contract_id_less(Contract a, Contract b) {
+    return a.getTransactionID() < b.getTransactionID();
 }
 
 void Agent::__load_contract() {
     DIR *dir;
     struct dirent *ent;
+    vector<Contract> contract_list;
     if ((dir = opendir (mContractRootDir.c_str())) != NULL) {
         while ((ent = readdir (dir)) != NULL) {
             string contract_file_name(ent->d_name);
-            if (contract_file_name == "." || contract_file_name == "..") {
+            if (contract_file_name.size() < 3
+                    || contract_file_name.compare(contract_file_name.size() - 3, 3, ".ct") != 0) {
                 continue;
             }
             string full_path = mContractRootDir + "/" + contract_file_name;
-            Contract contract = Contract(full_path);
-            mContractList.push_back(contract);
-            cout << contract.getDescription() << endl;
-            __encrypt_contract(contract);
+            contract_list.push_back(Contract(full_path));
         }
         closedir (dir);
     }
     else {
         perror ("Fail to open contract directory");
     }
+
+    // readdir order is arbitrary, the chain is ordered by transaction id
+    sort(contract_list.begin(), contract_list.end(), __contract_id_less);
+    vector<Contract> unindexed;
+    for (int i = 0; i < contract_list.size(); i++) {
+        Contract contract = contract_list[i];
+        mContractList.push_back(contract);
+        cout << contract.getDescription() << endl;
+        // tokens are only kept in memory, while only contracts missing
+        // from the trapdoor index are encrypted
+        if (mSearchIndex == SEARCH_INDEX_TOKEN || contract.getTransactionID() >= mTrapdoorIndex.getCount()) {
+            unindexed.push_back(contract);
+        }
+    }
+    __index_contracts(unindexed);
+    mNextTransactionID = (uint64_t)mContractList.size();
+}
+
+
+// Gives contracts the next contiguous range of transaction ids, writes
+// them to the chain directory, syncs it, and returns the first id. On
+// failure the files written so far are removed again. Called with the
+// ingest lock held; the ids are only taken once every contract is saved.
+uint64_t Agent::__append_contracts(vector<Contract> &contracts) {
+    uint64_t first_id = mNextTransactionID;
+    for (int i = 0; i < contracts.size(); i++) {
+        contracts[i].setTransactionID(first_id + i);
+        if (!__save_contract(contracts[i])) {
+            // a rejected batch must not come back as contracts on restart
+            __remove_contracts(first_id, i);
+            throw runtime_error("Fail to save contract " + to_string(first_id + i) + " to " + mContractRootDir);
+        }
+    }
+    if (!__sync_contract_dir()) {
+        __remove_contracts(first_id, contracts.size());
+        throw runtime_error("Fail to sync " + mContractRootDir);
+    }
+    mNextTransactionID += contracts.size();
+    return first_id;
+}
+
+void Agent::__remove_contracts(uint64_t first_id, size_t num_contracts) {
+    for (size_t i = 0; i < num_contracts; i++) {
+        unlink(__contract_path(first_id + i).c_str());
+    }
+    __sync_contract_dir();
+}
+
+// Makes appended contracts visible to searches and moves the watermark
+void Agent::__publish_contracts(vector<Contract> &contracts,
+                                vector<vector<vector<unsigned char>>> &trapdoor_lists) {
+    if (mSearchIndex == SEARCH_INDEX_TOKEN) {
+        for (int i = 0; i < contracts.size(); i++) {
+            __tokenize_contract(contracts[i]);
+        }
+    }
+    else {
+        __index_trapdoors(contracts, trapdoor_lists);
+    }
+    {
+        boost::unique_lock<boost::shared_mutex> index_lock(mLocks->index);
+        mContractList.insert(mContractList.end(), contracts.begin(), contracts.end());
+    }
+    lock_guard<mutex> lock(mLocks->watermark);
+    mLocks->indexed.notify_all();
+}
+
+uint64_t Agent::__ingest_contract(Contract contract) {
+    return __ingest_contracts(vector<Contract>(1, contract));
+}
+
+// Runs every ingestion stage on the calling thread, for an agent without
+// the pipeline (startup, benches). Concurrent calls are serialized,
+// searches keep running meanwhile.
+uint64_t Agent::__ingest_contracts(vector<Contract> contracts) {
+    lock_guard<mutex> lock(mLocks->ingest);
+    uint64_t first_id = __append_contracts(contracts);
+    vector<vector<vector<unsigned char>>> trapdoor_lists;
+    if (mSearchIndex == SEARCH_INDEX_PEKS) {
+        trapdoor_lists = __make_trapdoors(contracts);
+    }
+    __publish_contracts(contracts, trapdoor_lists);
+    return first_id;
+}
+
+// Appends contracts and hands them to the pipeline, which indexes them in
+// the background. Returns false, with nothing appended, while the queue
+// in front of the pipeline is full.
+bool Agent::__enqueue_contracts(vector<Contract> &contracts, uint64_t &first_id) {
+    lock_guard<mutex> lock(mLocks->ingest);
+    // only this function pushes, under the ingest lock, so the room
+    // cannot be taken in between
+    if (mPipeline->appended.Full()) {
+        return false;
+    }
+    first_id = __append_contracts(contracts);
+    IngestBatch batch;
+    batch.contracts = contracts;
+    mPipeline->appended.Push(batch);
+    return true;
+}
+
+// Takes the appended contracts, as many as are waiting up to
+// INGEST_MAX_BATCH, and makes their trapdoors in one go
+void Agent::__trapdoor_stage() {
+    IngestBatch batch;
+    while (mPipeline->appended.Pop(batch)) {
+        IngestBatch next;
+        while (batch.contracts.size() < INGEST_MAX_BATCH && mPipeline->appended.TryPop(next)) {
+            batch.contracts.insert(batch.contracts.end(), next.contracts.begin(), next.contracts.end());
+        }
+        if (mSearchIndex == SEARCH_INDEX_PEKS) {
+            batch.trapdoor_lists = __make_trapdoors(batch.contracts);
+            cout << "Trapdoor cache: " << mTrapdoorCache.getHits() << " hits, "
+                 << mTrapdoorCache.getMisses() << " misses, "
+                 << mTrapdoorCache.getBytes() << " bytes" << endl;
+        }
+        mPipeline->trapdoors.Push(batch);
+    }
+    mPipeline->trapdoors.Close();
+}
+
+void Agent::__index_stage() {
+    IngestBatch batch;
+    while (mPipeline->trapdoors.Pop(batch)) {
+        __publish_contracts(batch.contracts, batch.trapdoor_lists);
+    }
+}
+
+void Agent::__start_pipeline() {
+    mPipeline.reset(new IngestPipeline(mIngestQueueDepth));
+    mPipeline->threads.push_back(thread(&Agent::__trapdoor_stage, this));
+    mPipeline->threads.push_back(thread(&Agent::__index_stage, this));
+}
+
+// Blocks until every transaction below height is searchable
+void Agent::__wait_indexed(uint64_t height) {
+    unique_lock<mutex> lock(mLocks->watermark);
+    while (__chain_height() < height) {
+        mLocks->indexed.wait(lock);
+    }
+}
+
+uint64_t Agent::__appended_height() {
+    lock_guard<mutex> lock(mLocks->ingest);
+    return mNextTransactionID;
 }
 
+// Acks contracts once they are appended, with their first transaction id
+// and the watermark they have to pass to be searchable, or answers 429
+// while the pipeline is full
+void Agent::__answer_enqueue(shared_ptr<HttpServer::Response> response, vector<Contract> &contracts) {
+    uint64_t first_id;
+    if (!__enqueue_contracts(contracts, first_id)) {
+        string response_str = "Ingestion queue full";
+        *response << "HTTP/1.1 429 Too Many Requests\r\nRetry-After: 1\r\n"
+                  << "Content-Length: " << response_str.length() << "\r\n\r\n"
+                  << response_str;
+        return;
+    }
+    cout << contracts.size() << " contracts received!" << endl;
+    string response_str = "{\"first_transaction_id\": " + to_string(first_id)
+                          + ", \"count\": " + to_string(contracts.size())
+                          + ", \"indexed_height\": " + to_string(__chain_height()) + "}";
+    *response << "HTTP/1.1 200 OK\r\n"
+              << "Content-Length: " << response_str.length() << "\r\n\r\n"
+              << response_str;
+}
+
+// Transactions below indexed_height are searchable, those below
+// appended_height are durable
+void Agent::__recv_watermark(HttpServer &server) {
+    server.resource["^/watermark$"]["GET"] = [this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
+        string response_str = "{\"indexed_height\": " + to_string(__chain_height())
+                              + ", \"appended_height\": " + to_string(__appended_height()) + "}";
+        *response << "HTTP/1.1 200 OK\r\n"
+                  << "Content-Length: " << response_str.length() << "\r\n\r\n"
+                  << response_str;
+    };
+}
 
 void Agent::__recv_contract(HttpServer &server) {
     server.resource["^/contract$"]["POST"] = [this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
-        try {
-            string recv_string = request->content.string();
-            stringstream iarchive_stream;
-            iarchive_stream << recv_string;
-            boost::archive::text_iarchive iarchive(iarchive_stream);
-            Contract recv_contract = Contract();
-            iarchive >> recv_contract;
-
-            string response_str = "Contract received!";
-            cout << response_str << endl;
-            *response << "HTTP/1.1 200 OK\r\n"
-                      << "Content-Length: " << response_str.length() << "\r\n\r\n"
-                      << response_str;
-
-            uint64_t Transaction_ID = (uint64_t)mContractList.size();
-            recv_contract.setTransactionID(Transaction_ID);
-            __encrypt_contract(recv_contract);
-            mContractList.push_back(recv_contract);
-            __save_contract(recv_contract);
-        }
-        catch(const exception &e) {
-          *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << strlen(e.what()) << "\r\n\r\n"
-                    << e.what();
-        }
+        // read on the I/O thread, appended on the compute pool and indexed
+        // by the pipeline
+        string recv_string = request->content.string();
+        mComputePool->Submit([this, response, recv_string](size_t) {
+            try {
+                stringstream iarchive_stream;
+                iarchive_stream << recv_string;
+                boost::archive::text_iarchive iarchive(iarchive_stream);
+                vector<Contract> recv_contracts(1);
+                iarchive >> recv_contracts[0];
+                __answer_enqueue(response, recv_contracts);
+            }
+            catch(const exception &e) {
+              *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << strlen(e.what()) << "\r\n\r\n"
+                        << e.what();
+            }
+        });
     };
 }
 
-vector<uint64_t> Agent::__search_keyword(string keyword) {
-    pair<uint64_t, vector<element_s>> it;
+// A batch is a text archive of vector<Contract>. Its contracts get one
+// contiguous range of transaction ids, which the ack carries.
+void Agent::__recv_contract_batch(HttpServer &server) {
+    server.resource["^/contracts/batch$"]["POST"] = [this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
+        string recv_string = request->content.string();
+        mComputePool->Submit([this, response, recv_string](size_t) {
+            try {
+                stringstream iarchive_stream;
+                iarchive_stream << recv_string;
+                boost::archive::text_iarchive iarchive(iarchive_stream);
+                vector<Contract> recv_contracts;
+                iarchive >> recv_contracts;
+                if (recv_contracts.empty()) {
+                    throw invalid_argument("Empty contract batch");
+                }
+
+                __answer_enqueue(response, recv_contracts);
+            }
+            catch(const exception &e) {
+              *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << strlen(e.what()) << "\r\n\r\n"
+                        << e.what();
+            }
+        });
+    };
+}
+
+// Searches are answered from the result cache where possible: only the
+// trapdoors added to the vocabulary (or to the column of field) since the
+// cached result are tested, and the transactions indexed since its height
+// are appended to it. The watermarks of a search are taken together under
+// the index lock, so its result is the chain as of one contract.
+// With progress the new trapdoors are tested SEARCH_STREAM_SLICE at a
+// time and progress gets the transactions every slice found; a search it
+// stops returns what was found so far and is not cached.
+vector<uint64_t> Agent::__search_keyword(string keyword, int field, SearchProgress progress) {
+    if (mSearchIndex == SEARCH_INDEX_TOKEN) {
+        vector<uint64_t> Transaction_IDs;
+        {
+            boost::shared_lock<boost::shared_mutex> lock(mLocks->index);
+            Transaction_IDs = mTokenIndex.Lookup(keyword, field);
+        }
+        if (progress) {
+            progress(Transaction_IDs, 0, 0);
+        }
+        return Transaction_IDs;
+    }
+
+    bool scoped = field != FIELD_ANY;
+    string cache_key = __search_cache_key(keyword, field);
+    SearchResult result;
+    {
+        lock_guard<mutex> lock(mLocks->search_cache);
+        mSearchResultCache.Get(cache_key, result);
+    }
+
+    uint64_t vocabulary_size;
+    uint64_t height;
+    vector<uint64_t> column;
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mLocks->index);
+        vocabulary_size = scoped ? mFieldColumns[field].vocabulary.size() : mTrapdoorVocabulary.size();
+        height = mIndexedHeight;
+        if (scoped && result.vocabulary_size < vocabulary_size) {
+            column.assign(mFieldColumns[field].vocabulary.begin() + result.vocabulary_size,
+                          mFieldColumns[field].vocabulary.begin() + vocabulary_size);
+        }
+    }
+
+    // the cached transactions and those indexed since; posting lists are
+    // ascending, so the latter all come after the former
+    vector<uint64_t> Transaction_IDs = result.transaction_ids;
+    vector<uint64_t> indexed_since = __collect_postings(result.matches, 0, field, result.height, height);
+    Transaction_IDs.insert(Transaction_IDs.end(), indexed_since.begin(), indexed_since.end());
+
+    uint64_t begin = result.vocabulary_size;
+    uint64_t num_untested = begin < vocabulary_size ? vocabulary_size - begin : 0;
+    if (progress && !progress(Transaction_IDs, 0, num_untested)) {
+        return Transaction_IDs;
+    }
+
+    if (num_untested > 0) {
+        // the query side of the PEKS test only depends on the keyword,
+        // so build it once and test it against every new distinct trapdoor
+        PeksQuery query;
+        query.Build(keyword, mKey, mPairing, mHashFormat);
+
+        uint64_t slice = progress ? SEARCH_STREAM_SLICE : num_untested;
+        for (uint64_t lo = begin; lo < vocabulary_size; lo += slice) {
+            uint64_t hi = min(vocabulary_size, lo + slice);
+            vector<uint64_t> matches;
+            if (scoped) {
+                matches = mSearchExecutor.Scan(query, mTrapdoorVocabulary, column.data() + (lo - begin),
+                                               hi - lo, mPairing);
+            }
+            else {
+                matches = mSearchExecutor.Scan(query, mTrapdoorVocabulary, lo, hi - lo, mPairing);
+            }
+            size_t first_match = result.matches.size();
+            for (int i = 0; i < matches.size(); i++) {
+                result.matches.push_back(lo + matches[i]);
+            }
+
+            // a transaction may hold several matching trapdoors
+            vector<uint64_t> found = __collect_postings(result.matches, first_match, field, 0, height);
+            vector<uint64_t> fresh, merged;
+            set_difference(found.begin(), found.end(), Transaction_IDs.begin(), Transaction_IDs.end(),
+                           back_inserter(fresh));
+            set_union(Transaction_IDs.begin(), Transaction_IDs.end(), fresh.begin(), fresh.end(),
+                      back_inserter(merged));
+            Transaction_IDs.swap(merged);
+            if (progress && !progress(fresh, hi - begin, num_untested)) {
+                return Transaction_IDs;
+            }
+        }
+    }
+
+    result.transaction_ids = Transaction_IDs;
+    result.vocabulary_size = vocabulary_size;
+    result.height = height;
+    {
+        lock_guard<mutex> lock(mLocks->search_cache);
+        mSearchResultCache.Put(cache_key, result);
+    }
+    return Transaction_IDs;
+}
+
+// The transactions in [from, to) of the posting lists of matches[first..],
+// vocabulary entries or, with a field, column positions, ascending
+vector<uint64_t> Agent::__collect_postings(const vector<uint64_t> &matches, size_t first, int field,
+                                           uint64_t from, uint64_t to) {
     vector<uint64_t> Transaction_IDs;
-    BOOST_FOREACH(it, mContract2TrapdoorMap) {
-        uint64_t Transaction_ID;
-        Transaction_ID = it.first;
-        vector<element_s> trapdoor_list = mContract2TrapdoorMap[Transaction_ID];
-        for(int i=0; i<trapdoor_list.size(); i++) {
-            element_t Tw = {trapdoor_list[i].field, trapdoor_list[i].data};
-            char* keyword_c = (char*) keyword.c_str();
-            int match = Test(keyword_c, (int)strlen(keyword_c), &mKey.pub, Tw, mPairing);
-            if(match) {
-                Transaction_IDs.push_back(Transaction_ID);
-                break;
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mLocks->index);
+        for (size_t i = first; i < matches.size(); i++) {
+            vector<uint64_t> &postings = field != FIELD_ANY ? mFieldColumns[field].postings[matches[i]]
+                                                            : mTrapdoorPostings[matches[i]];
+            vector<uint64_t>::iterator lo = lower_bound(postings.begin(), postings.end(), from);
+            vector<uint64_t>::iterator hi = lower_bound(lo, postings.end(), to);
+            Transaction_IDs.insert(Transaction_IDs.end(), lo, hi);
+        }
+    }
+    sort(Transaction_IDs.begin(), Transaction_IDs.end());
+    Transaction_IDs.erase(unique(Transaction_IDs.begin(), Transaction_IDs.end()), Transaction_IDs.end());
+    return Transaction_IDs;
+}
+
+string Agent::__search_cache_key(string keyword, int field) {
+    return string(1, (char)(field + 1)) + keyword;
+}
+
+int Agent::__term_field(const QueryNode &node) {
+    int field = __parse_field(node.field);
+    if (field == FIELD_UNKNOWN) {
+        throw invalid_argument("Unknown field " + node.field);
+    }
+    return field;
+}
+
+// Pairings a query costs over the whole chain, the order in which the
+// operands of AND and OR are evaluated. Cached terms and token lookups
+// are free, a scoped term only scans its column.
+uint64_t Agent::__query_cost(const QueryNode &node) {
+    if (node.type == QUERY_TERM) {
+        int field = __term_field(node);
+        if (mSearchIndex == SEARCH_INDEX_TOKEN) {
+            return 0;
+        }
+        {
+            lock_guard<mutex> lock(mLocks->search_cache);
+            if (mSearchResultCache.Contains(__search_cache_key(node.keyword, field))) {
+                return 0;
             }
         }
+        boost::shared_lock<boost::shared_mutex> lock(mLocks->index);
+        return field == FIELD_ANY ? mTrapdoorVocabulary.size() : mFieldColumns[field].vocabulary.size();
+    }
+    uint64_t cost = 0;
+    for (int i = 0; i < node.children.size(); i++) {
+        cost += __query_cost(node.children[i]);
+    }
+    return cost;
+}
 
+vector<uint64_t> Agent::__children_by_cost(const QueryNode &node) {
+    vector<pair<uint64_t, uint64_t>> costs;
+    for (uint64_t i = 0; i < node.children.size(); i++) {
+        costs.push_back(pair<uint64_t, uint64_t>(__query_cost(node.children[i]), i));
+    }
+    sort(costs.begin(), costs.end());
+    vector<uint64_t> order;
+    for (int i = 0; i < costs.size(); i++) {
+        order.push_back(costs[i].second);
+    }
+    return order;
+}
+
+uint64_t Agent::__chain_height() {
+    boost::shared_lock<boost::shared_mutex> lock(mLocks->index);
+    return mIndexedHeight;
+}
+
+// Transactions matching a boolean query, in ascending order. The query is
+// evaluated against the chain as of the height it started at, so the
+// contracts ingested meanwhile do not show up in only some of its operands.
+vector<uint64_t> Agent::__search_query(const QueryNode &node) {
+    return __evaluate_query(node, __chain_height());
+}
+
+// The cheapest positive operand of an AND is searched over the chain below
+// height and the others are only tested against the transactions it left.
+vector<uint64_t> Agent::__evaluate_query(const QueryNode &node, uint64_t height) {
+    vector<uint64_t> Transaction_IDs;
+    if (node.type == QUERY_TERM) {
+        Transaction_IDs = __search_keyword(node.keyword, __term_field(node));
+        Transaction_IDs.erase(lower_bound(Transaction_IDs.begin(), Transaction_IDs.end(), height),
+                              Transaction_IDs.end());
+        return Transaction_IDs;
+    }
+    if (node.type == QUERY_NOT) {
+        vector<uint64_t> excluded = __evaluate_query(node.children[0], height);
+        for (uint64_t i = 0, j = 0; i < height; i++) {
+            if (j < excluded.size() && excluded[j] == i) {
+                j++;
+            }
+            else {
+                Transaction_IDs.push_back(i);
+            }
+        }
+        return Transaction_IDs;
+    }
+    if (node.type == QUERY_OR) {
+        for (int i = 0; i < node.children.size(); i++) {
+            vector<uint64_t> matches = __evaluate_query(node.children[i], height);
+            vector<uint64_t> merged;
+            set_union(Transaction_IDs.begin(), Transaction_IDs.end(), matches.begin(), matches.end(),
+                      back_inserter(merged));
+            Transaction_IDs.swap(merged);
+        }
+        return Transaction_IDs;
+    }
+
+    vector<uint64_t> order = __children_by_cost(node);
+    int first = 0;
+    while (first < order.size() && node.children[order[first]].type == QUERY_NOT) {
+        first++;
+    }
+    if (first < order.size()) {
+        Transaction_IDs = __evaluate_query(node.children[order[first]], height);
+    }
+    else {
+        for (uint64_t i = 0; i < height; i++) {
+            Transaction_IDs.push_back(i);
+        }
+    }
+    for (int i = 0; i < order.size() && !Transaction_IDs.empty(); i++) {
+        if (i != first) {
+            Transaction_IDs = __filter_query(node.children[order[i]], Transaction_IDs);
+        }
+    }
+    return Transaction_IDs;
+}
+
+// The candidates matching a query, in ascending order. Every operand only
+// sees the candidates still undecided: AND drops the ones an operand
+// rejects, OR stops testing the ones an operand accepted.
+vector<uint64_t> Agent::__filter_query(const QueryNode &node, const vector<uint64_t> &candidates) {
+    vector<uint64_t> Transaction_IDs;
+    if (node.type == QUERY_TERM) {
+        return __filter_term(node, candidates);
+    }
+    if (node.type == QUERY_NOT) {
+        vector<uint64_t> excluded = __filter_query(node.children[0], candidates);
+        set_difference(candidates.begin(), candidates.end(), excluded.begin(), excluded.end(),
+                       back_inserter(Transaction_IDs));
+        return Transaction_IDs;
+    }
+
+    vector<uint64_t> order = __children_by_cost(node);
+    if (node.type == QUERY_AND) {
+        Transaction_IDs = candidates;
+        for (int i = 0; i < order.size() && !Transaction_IDs.empty(); i++) {
+            Transaction_IDs = __filter_query(node.children[order[i]], Transaction_IDs);
+        }
+        return Transaction_IDs;
+    }
+
+    vector<uint64_t> undecided = candidates;
+    for (int i = 0; i < order.size() && !undecided.empty(); i++) {
+        vector<uint64_t> matches = __filter_query(node.children[order[i]], undecided);
+        vector<uint64_t> merged, rest;
+        set_union(Transaction_IDs.begin(), Transaction_IDs.end(), matches.begin(), matches.end(),
+                  back_inserter(merged));
+        set_difference(undecided.begin(), undecided.end(), matches.begin(), matches.end(),
+                       back_inserter(rest));
+        Transaction_IDs.swap(merged);
+        undecided.swap(rest);
+    }
+    return Transaction_IDs;
+}
+
+// Tests a keyword against the trapdoors of the candidates only, each
+// distinct trapdoor at most once and no further trapdoors of a candidate
+// once one matched. Falls back to a full search when that is as cheap.
+vector<uint64_t> Agent::__filter_term(const QueryNode &node, const vector<uint64_t> &candidates) {
+    int field = __term_field(node);
+    vector<uint64_t> Transaction_IDs;
+
+    // the trapdoor lists are copied, so the pairings run without the lock
+    uint64_t num_tests = 0;
+    vector<vector<uint64_t>> candidate_trapdoors(candidates.size());
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mLocks->index);
+        for (int i = 0; i < candidates.size(); i++) {
+            if (candidates[i] < mTransactionTrapdoors.size()) {
+                num_tests += mTransactionTrapdoors[candidates[i]].size();
+            }
+        }
+    }
+    if (num_tests >= __query_cost(node)) {
+        vector<uint64_t> matches = __search_keyword(node.keyword, field);
+        set_intersection(candidates.begin(), candidates.end(), matches.begin(), matches.end(),
+                         back_inserter(Transaction_IDs));
+        return Transaction_IDs;
+    }
+
+    PeksQuery query;
+    query.Build(node.keyword, mKey, mPairing, mHashFormat);
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mLocks->index);
+        for (int i = 0; i < candidates.size(); i++) {
+            if (candidates[i] < mTransactionTrapdoors.size()) {
+                candidate_trapdoors[i] = mTransactionTrapdoors[candidates[i]];
+            }
+        }
+    }
+    Element scratch;
+    scratch.initG1(mPairing);
+    unordered_map<uint64_t, bool> tested;
+    for (int i = 0; i < candidates.size(); i++) {
+        vector<uint64_t> &trapdoors = candidate_trapdoors[i];
+        for (int j = 0; j < trapdoors.size(); j++) {
+            if (field != FIELD_ANY && __word_field(j) != field) {
+                continue;
+            }
+            unordered_map<uint64_t, bool>::iterator it = tested.find(trapdoors[j]);
+            bool match;
+            if (it != tested.end()) {
+                match = it->second;
+            }
+            else {
+                scratch.fromBytes(mTrapdoorVocabulary.get(trapdoors[j]));
+                match = query.Test(scratch, mPairing);
+                tested.insert(pair<uint64_t, bool>(trapdoors[j], match));
+            }
+            if (match) {
+                Transaction_IDs.push_back(candidates[i]);
+                break;
+            }
+        }
     }
     return Transaction_IDs;
 }
 
 void Agent::__recv_searchrequest(HttpServer &server) {
-    thread search_request_thread([this, &server] {
     server.resource["^/searchrequest$"]["POST"] = [this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
-        try {
-            ptree pt;
-            read_json(request->content, pt);
-            string keyword;
-            keyword = pt.get<string>("keyword");
-            cout << "Recieve a search request with keyword " << keyword << endl;
-            const clock_t begin_time = clock();
-            //serialize the transaction id vector and send to supervisor
-            vector<uint64_t> found_trans_id_list = __search_keyword(keyword);
-            stringstream archive_stream;
-            boost::archive::text_oarchive archive(archive_stream);
-            archive << found_trans_id_list;
-            cout << "Found " << found_trans_id_list.size() << " records for keyword " << keyword <<"." << endl;
-            std::cout << "The search time is " << float( clock () - begin_time ) /  CLOCKS_PER_SEC << std::endl;
-
-            *response << "HTTP/1.1 200 OK\r\n"
-                      << "Content-Length: " << archive_stream.str().length() << "\r\n\r\n"
-                      << archive_stream.str();
-        }
-        catch(const exception &e) {
-          *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << strlen(e.what()) << "\r\n\r\n"
-                    << e.what();
+        // the scan runs on the compute pool, which answers once it is done
+        string content = request->content.string();
+        mComputePool->Submit([this, response, content](size_t) {
+            try {
+                ptree pt;
+                stringstream content_stream(content);
+                read_json(content_stream, pt);
+                // either a boolean query over keywords or a single keyword
+                boost::optional<string> query_text = pt.get_optional<string>("query");
+                string keyword;
+                int field = FIELD_ANY;
+                QueryNode query;
+                if (query_text) {
+                    keyword = *query_text;
+                    query = ParseSearchQuery(keyword, __is_field);
+                    __check_query(query);
+                }
+                else {
+                    keyword = pt.get<string>("keyword");
+                    // optional, searches every field when missing
+                    string field_name = pt.get<string>("field", "");
+                    field = __parse_field(field_name);
+                    if (field == FIELD_UNKNOWN) {
+                        throw invalid_argument("Unknown field " + field_name);
+                    }
+                }
+                // optional: answer in chunks as the scan finds transactions,
+                // and stop once limit of them are found (0 for all)
+                bool stream = pt.get<bool>("stream", false);
+                uint64_t limit = pt.get<uint64_t>("limit", 0);
+                cout << "Recieve a search request with keyword " << keyword << endl;
+                if (stream) {
+                    // not timed, the chunks wait on the network
+                    __stream_search(response, query_text ? &query : NULL, keyword, field, limit);
+                    return;
+                }
+
+                // wall time: clock() would add in every search and the
+                // ingestion running alongside
+                chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+                //serialize the transaction id vector and send to supervisor
+                vector<uint64_t> found_trans_id_list;
+                if (query_text) {
+                    found_trans_id_list = __search_query(query);
+                }
+                else if (limit > 0) {
+                    // found in slices, so the scan can stop at the limit
+                    uint64_t num_found = 0;
+                    found_trans_id_list = __search_keyword(keyword, field,
+                        [&num_found, limit](const vector<uint64_t> &new_ids, uint64_t scanned, uint64_t total) {
+                            num_found += new_ids.size();
+                            return num_found < limit;
+                        });
+                }
+                else {
+                    found_trans_id_list = __search_keyword(keyword, field);
+                }
+                if (limit > 0 && found_trans_id_list.size() > limit) {
+                    found_trans_id_list.resize(limit);
+                }
+                stringstream archive_stream;
+                boost::archive::text_oarchive archive(archive_stream);
+                archive << found_trans_id_list;
+                cout << "Found " << found_trans_id_list.size() << " records for keyword " << keyword <<"." << endl;
+                std::cout << "The search time is "
+                          << chrono::duration<double>(chrono::steady_clock::now() - begin).count() << " s" << std::endl;
+                if (mSearchIndex == SEARCH_INDEX_PEKS) {
+                    lock_guard<mutex> lock(mLocks->search_cache);
+                    cout << "Search cache: " << mSearchResultCache.getHits() << " hits, "
+                         << mSearchResultCache.getMisses() << " misses, hit ratio "
+                         << mSearchResultCache.getHitRatio() << ", "
+                         << mSearchResultCache.getBytes() << " bytes" << endl;
+                }
+
+                *response << "HTTP/1.1 200 OK\r\n"
+                          << "Content-Length: " << archive_stream.str().length() << "\r\n\r\n"
+                          << archive_stream.str();
+            }
+            catch(const exception &e) {
+              *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << strlen(e.what()) << "\r\n\r\n"
+                        << e.what();
+            }
+        });
+    };
+}
+
+// Answers a search with chunked transfer encoding, one JSON line per
+// chunk: the transactions found since the previous chunk (not ascending
+// across chunks), how many of the untested trapdoors were tested out of
+// how many, and the transactions found so far. A boolean query is
+// evaluated whole and answered in one chunk. The scan stops once limit
+// transactions are sent (0 for no limit) or the supervisor is gone. The
+// request is checked before, so a search failing once the 200 is out
+// ends the stream with an {"error": ...} line.
+void Agent::__stream_search(shared_ptr<HttpServer::Response> response, const QueryNode *query,
+                            string keyword, int field, uint64_t limit) {
+    *response << "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+    uint64_t num_found = 0;
+    bool connected = true;
+    SearchProgress progress = [&](const vector<uint64_t> &new_ids, uint64_t scanned, uint64_t total) {
+        size_t num_ids = new_ids.size();
+        if (limit > 0 && num_found + num_ids > limit) {
+            num_ids = limit - num_found;
+        }
+        num_found += num_ids;
+        stringstream chunk;
+        chunk << "{\"transaction_ids\": [";
+        for (int i = 0; i < num_ids; i++) {
+            chunk << (i ? ", " : "") << new_ids[i];
         }
+        chunk << "], \"scanned\": " << scanned << ", \"total\": " << total
+              << ", \"found\": " << num_found << "}\n";
+        connected = __send_chunk(response, chunk.str());
+        return connected && (limit == 0 || num_found < limit);
     };
+
+    try {
+        if (query != NULL) {
+            vector<uint64_t> Transaction_IDs = __search_query(*query);
+            progress(Transaction_IDs, 0, 0);
+        }
+        else {
+            __search_keyword(keyword, field, progress);
+        }
+        cout << "Streamed " << num_found << " records for keyword " << keyword << "." << endl;
+    }
+    catch(const exception &e) {
+        cout << "Search for keyword " << keyword << " failed: " << e.what() << endl;
+        if (connected) {
+            ptree pt;
+            pt.put("error", e.what());
+            stringstream chunk;
+            write_json(chunk, pt, false);
+            connected = __send_chunk(response, chunk.str());
+        }
+    }
+    // the last chunk goes out once the response is released; a closed
+    // connection gets nothing more
+    if (connected) {
+        *response << "0\r\n\r\n";
+    }
+}
+
+// Writes data as one chunk and waits until it is on the wire, false when
+// the supervisor is gone. A write that does not finish in time has its
+// connection closed, so nothing is written after it.
+bool Agent::__send_chunk(shared_ptr<HttpServer::Response> response, string data) {
+    if (data.empty()) {
+        return true;
+    }
+    *response << hex << data.length() << dec << "\r\n" << data << "\r\n";
+    shared_ptr<promise<bool>> sent = make_shared<promise<bool>>();
+    future<bool> sent_future = sent->get_future();
+    response->send([sent](const SimpleWeb::error_code &ec) {
+        sent->set_value(!ec);
     });
-    search_request_thread.detach();
+    // the callback is dropped when the server stops
+    if (sent_future.wait_for(chrono::seconds(SEARCH_STREAM_TIMEOUT)) != future_status::ready) {
+        response->close();
+        return false;
+    }
+    if (!sent_future.get()) {
+        response->close();
+        return false;
+    }
+    return true;
 }
 
+// Throws invalid_argument on a term with an unknown field, which the
+// evaluation would only find halfway
+void Agent::__check_query(const QueryNode &node) {
+    if (node.type == QUERY_TERM) {
+        __term_field(node);
+        return;
+    }
+    for (int i = 0; i < node.children.size(); i++) {
+        __check_query(node.children[i]);
+    }
+}
+
+// Requests are read and answered on HTTP_THREADS I/O threads, while the
+// ingestion and searches they ask for run on COMPUTE_THREADS workers, so a
+// long scan never holds up the I/O threads. Searches and ingestion may
+// run side by side, see AgentLocks.
 void Agent::serve() {
+    if (!mComputePool) {
+        mComputePool.reset(new ThreadPool(mComputeThreads));
+    }
+    if (!mPipeline) {
+        __start_pipeline();
+    }
     HttpServer server;
     server.config.port = stoi(mOpenPort);
+    server.config.thread_pool_size = mHttpThreads;
     this->__recv_searchrequest(server);
     this->__recv_contract(server);
+    this->__recv_contract_batch(server);
+    this->__recv_watermark(server);
     thread server_thread([&server]() {
         // Start server
         server.start();
@@ -442,18 +1372,50 @@ void Agent::test() {
     __save_contract(contract1);
     __save_contract(contract2);
     __save_contract(contract3);
-    __encrypt_contract(contract1);
-    __encrypt_contract(contract2);
-    __encrypt_contract(contract3);
-    HttpServer server;
-    server.config.port = stoi(mOpenPort);
-    this->__recv_searchrequest(server);
-    this->__recv_contract(server);
-    thread server_thread([&server]() {
-        // Start server
-        server.start();
-    });
-    server_thread.join();
+    __index_contract(contract1);
+    __index_contract(contract2);
+    __index_contract(contract3);
+    serve();
+}
+
+// serve() starts the pipeline itself
+void Agent::StartPipeline() {
+    if (!mPipeline) {
+        __start_pipeline();
+    }
+}
+
+// Makes trapdoors for contracts and indexes them without appending them
+// to the chain, as done for the contracts found on startup
+void Agent::IndexContracts(vector<Contract> contracts) {
+    lock_guard<mutex> lock(mLocks->ingest);
+    __index_contracts(contracts);
+}
+
+uint64_t Agent::IngestContracts(vector<Contract> contracts) {
+    return __ingest_contracts(contracts);
+}
+
+// Needs StartPipeline(); false while the pipeline is full
+bool Agent::EnqueueContracts(vector<Contract> contracts, uint64_t &first_id) {
+    return __enqueue_contracts(contracts, first_id);
+}
+
+void Agent::WaitIndexed(uint64_t height) {
+    __wait_indexed(height);
+}
+
+vector<uint64_t> Agent::SearchKeyword(string keyword, int field, SearchProgress progress) {
+    return __search_keyword(keyword, field, progress);
+}
+
+vector<uint64_t> Agent::SearchQuery(string query) {
+    return __search_query(ParseSearchQuery(query, __is_field));
+}
+
+void Agent::setSearchCacheBytes(size_t capacity_bytes) {
+    lock_guard<mutex> lock(mLocks->search_cache);
+    mSearchResultCache.setCapacity(capacity_bytes);
 }
 
 void Agent::setAddr(string Addr) {
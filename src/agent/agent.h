@@ -1,8 +1,17 @@
 #ifndef AGENT_H
 #define AGENT_H
 
+#include <chrono>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
 #include <gmp.h>
 #include <pbc/pbc.h>
 #include <dirent.h>
@@ -11,25 +20,128 @@
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/map.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 #define BOOST_SPIRIT_THREADSAFE
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
 #include "peks/peks.h"
+#include "peks/pbcwrapper.h"
+#include "peks/pbcpool.h"
+#include "trapdoorindexfile.h"
+#include "trapdoorcache.h"
+#include "searchexecutor.h"
+#include "tokenindex.h"
+#include "searchresultcache.h"
+#include "searchquery.h"
+#include "boundedqueue.h"
+#include "threadpool/threadpool.h"
 #include "contract/contract.h"
 #include "httpimpl/server_http.hpp"
 #include "configparser/configparser.h"
 
+#define DEFAULT_TRAPDOOR_CACHE_BYTES (16 << 20)
+#define DEFAULT_SEARCH_CACHE_BYTES (4 << 20)
+
+// SEARCH_INDEX of agent_info: pairing scan over the PEKS trapdoors, or
+// lookup of keyed word tokens in the token index
+#define SEARCH_INDEX_PEKS 0
+#define SEARCH_INDEX_TOKEN 1
+
+// Contract fields a trapdoor can come from, in the order __contract_words
+// lists the words of a contract; every word after the product is part of
+// the description
+#define FIELD_TXID 0
+#define FIELD_BUYER 1
+#define FIELD_SELLER 2
+#define FIELD_PRICE 3
+#define FIELD_PRODUCT 4
+#define FIELD_DESCRIPTION 5
+#define NUM_FIELDS 6
+// a search over every field, and a field name that is not known
+#define FIELD_ANY -1
+#define FIELD_UNKNOWN -2
+
 using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 using namespace std;
 using namespace boost::property_tree;
 
+// Locks of an agent serving requests on several threads. index guards
+// everything a search reads: ingestion computes outside of it and then
+// publishes a whole contract under an exclusive lock, searches copy what
+// they need under short shared locks and pair without holding it (the
+// TrapdoorStore may be read while it grows). ingest guards the contract
+// files and the next transaction id. The trapdoor cache and the trapdoor
+// index file have a single writer instead: once the pipeline runs, the
+// trapdoor stage writes the cache and the index stage the index file,
+// each on its own thread and outside of ingest; without the pipeline,
+// whoever ingests writes both under ingest. search_cache guards the
+// result cache. indexed is signalled under watermark whenever the
+// indexed height moves.
+struct AgentLocks {
+    boost::shared_mutex index;
+    mutex ingest;
+    mutex search_cache;
+    mutex watermark;
+    condition_variable indexed;
+};
+
+// batches waiting in front of the pipeline before contracts get a 429
+#define DEFAULT_INGEST_QUEUE_DEPTH 64
+// contracts the trapdoor stage makes trapdoors for in one go
+#define INGEST_MAX_BATCH 256
+
+// Contracts travelling through the ingestion pipeline, with their
+// trapdoors once the trapdoor stage made them
+struct IngestBatch {
+    vector<Contract> contracts;
+    vector<vector<vector<unsigned char>>> trapdoor_lists;
+};
+
+// Background stages of ingestion. Appended contracts queue for the
+// trapdoor stage, their trapdoors queue for the index stage, which
+// publishes them to searches in transaction id order. Closing the first
+// queue drains and stops both stages.
+struct IngestPipeline {
+    BoundedQueue<IngestBatch> appended;
+    BoundedQueue<IngestBatch> trapdoors;
+    vector<thread> threads;
+
+    IngestPipeline(size_t depth) : appended(depth), trapdoors(depth) {}
+    ~IngestPipeline() {
+        appended.Close();
+        for (int i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+};
+
+// vocabulary entries a streaming search tests between two chunks
+#define SEARCH_STREAM_SLICE 1024
+// seconds a streaming search waits for a chunk to be written
+#define SEARCH_STREAM_TIMEOUT 30
+
+// Called by a search with the transactions found since the last call,
+// and how many of the untested trapdoors it has tested so far; returning
+// false stops the search
+typedef function<bool(const vector<uint64_t> &new_ids, uint64_t scanned, uint64_t total)> SearchProgress;
+
+// Trapdoors occurring in one contract field: their vocabulary entries,
+// the transactions having each of them in that field, and the position of
+// a vocabulary entry in the column
+struct TrapdoorColumn {
+    vector<uint64_t> vocabulary;
+    vector<vector<uint64_t>> postings;
+    unordered_map<uint64_t, uint64_t> positions;
+};
+
 class Agent
 {
 public:
     Agent();
-    Agent(string agent_info_path, string contract_root_dir);
+    Agent(string agent_info_path, string contract_root_dir, bool gen_params = false);
     void setIPAddr(string IPAddr);
     void setAddr(string Addr);
     void setOpenPort(string OpenPort);
@@ -41,29 +153,128 @@ public:
     void test();
     void serve();
 
+    // What the request handlers do, without HTTP, for the benches
+    void StartPipeline();
+    void IndexContracts(vector<Contract> contracts);
+    uint64_t IngestContracts(vector<Contract> contracts);
+    bool EnqueueContracts(vector<Contract> contracts, uint64_t &first_id);
+    void WaitIndexed(uint64_t height);
+    vector<uint64_t> SearchKeyword(string keyword, int field = FIELD_ANY, SearchProgress progress = nullptr);
+    vector<uint64_t> SearchQuery(string query);
+    void setSearchCacheBytes(size_t capacity_bytes);
+
 private:
-    map<uint64_t, vector<element_s>> mContract2TrapdoorMap;
-    key mKey;
-    pbc_param_t mParam;
-    pairing_t mPairing;
+    // the pairing is declared first so every element made on it is
+    // cleared before it
+    Pairing mPairing;
+    // curve of newly generated parameters
+    peks_curve mCurve;
+    unsigned char mParamHash[SHA256_DIGEST_LENGTH];
+    KeyPair mKey;
+    // PEKS_HASH_* of the trapdoors in the index
+    int mHashFormat;
+    // distinct trapdoors of the chain, the transactions containing each of
+    // them, and the lookup from serialized trapdoor to vocabulary entry
+    TrapdoorStore mTrapdoorVocabulary;
+    vector<vector<uint64_t>> mTrapdoorPostings;
+    unordered_map<string, uint64_t> mTrapdoor2VocabularyMap;
+    // vocabulary entries of every transaction in __contract_words order,
+    // for testing a query against a few candidate transactions
+    vector<vector<uint64_t>> mTransactionTrapdoors;
+    // the vocabulary split by the field a trapdoor occurs in, so scoped
+    // searches only pair against one column
+    TrapdoorColumn mFieldColumns[NUM_FIELDS];
+    // one past the highest transaction in the posting lists, the
+    // watermark below which transactions are searchable
+    uint64_t mIndexedHeight;
+    // the id the next appended contract gets
+    uint64_t mNextTransactionID;
+    SearchResultCache mSearchResultCache;
     string mIPAddr;
     string mAddr;
     string mOpenPort;
     string mContractRootDir;
+    string mParamPath;
+    string mKeyPath;
+    string mTrapdoorIndexPath;
+    // held by pointer so the agent stays movable
+    unique_ptr<AgentLocks> mLocks;
+    size_t mHttpThreads;
+    size_t mComputeThreads;
+    // started by serve(), runs what the request handlers post
+    unique_ptr<ThreadPool> mComputePool;
+    size_t mIngestQueueDepth;
+    TrapdoorIndexFile mTrapdoorIndex;
+    TrapdoorCache mTrapdoorCache;
+    SearchExecutor mSearchExecutor;
+    int mSearchIndex;
+    TokenIndex mTokenIndex;
     int mNumContract;
+    // started by serve(); declared last so its stages stop before
+    // anything they use is destroyed
+    unique_ptr<IngestPipeline> mPipeline;
 
+    void __load_param(bool gen_params);
+    static vector<string> __contract_words(Contract contract);
+    static int __word_field(size_t word_index);
+    static int __parse_field(string field_name);
+    static bool __is_field(const string &field_name);
     void __encrypt_contract(Contract contract);
+    void __encrypt_contracts(vector<Contract> contracts);
+    vector<vector<vector<unsigned char>>> __make_trapdoors(vector<Contract> &contracts);
+    void __index_trapdoors(vector<Contract> &contracts,
+                           vector<vector<vector<unsigned char>>> &trapdoor_lists);
+    void __tokenize_contract(Contract contract);
+    void __index_contract(Contract contract);
+    void __index_contracts(vector<Contract> contracts);
+    uint64_t __ingest_contract(Contract contract);
+    uint64_t __ingest_contracts(vector<Contract> contracts);
+    uint64_t __append_contracts(vector<Contract> &contracts);
+    void __publish_contracts(vector<Contract> &contracts,
+                             vector<vector<vector<unsigned char>>> &trapdoor_lists);
+    bool __enqueue_contracts(vector<Contract> &contracts, uint64_t &first_id);
+    void __trapdoor_stage();
+    void __index_stage();
+    void __start_pipeline();
+    void __wait_indexed(uint64_t height);
+    uint64_t __appended_height();
+    void __derive_token_key();
+    void __index_trapdoor(uint64_t transaction_id, const vector<unsigned char> &trapdoor_bytes,
+                          int field);
     vector<Contract> mRecvContractList;
     void __recv_contract(HttpServer& server);
+    void __recv_contract_batch(HttpServer& server);
+    void __recv_watermark(HttpServer& server);
+    void __answer_enqueue(shared_ptr<HttpServer::Response> response, vector<Contract> &contracts);
     void __recv_searchrequest(HttpServer& server);
-    void __save_encryptedcontract(vector<vector<unsigned char>> trapdoor_list);
+    void __stream_search(shared_ptr<HttpServer::Response> response, const QueryNode *query,
+                         string keyword, int field, uint64_t limit);
+    static bool __send_chunk(shared_ptr<HttpServer::Response> response, string data);
+    void __save_encryptedcontracts(vector<Contract> &contracts,
+                                   const vector<vector<vector<unsigned char>>> &trapdoor_lists);
     void __load_encryptedcontract();
+    bool __decompress_index(const unsigned char *key_id);
     void __save_key(string key_file_path);
-    void __load_key(string key_file_path);
-    void __save_contract(Contract contract);
+    bool __load_key(string key_file_path);
+    bool __save_contract(Contract contract);
+    string __contract_path(uint64_t transaction_id);
+    bool __sync_contract_dir();
+    void __remove_contracts(uint64_t first_id, size_t num_contracts);
     void __load_contract();
     vector<Contract> mContractList;
-    vector<uint64_t> __search_keyword(string keyword);
+    vector<uint64_t> __search_keyword(string keyword, int field = FIELD_ANY, SearchProgress progress = nullptr);
+    vector<uint64_t> __collect_postings(const vector<uint64_t> &matches, size_t first, int field,
+                                        uint64_t from, uint64_t to);
+    static string __search_cache_key(string keyword, int field);
+    static int __term_field(const QueryNode &node);
+    static void __check_query(const QueryNode &node);
+    uint64_t __query_cost(const QueryNode &node);
+    vector<uint64_t> __children_by_cost(const QueryNode &node);
+    uint64_t __chain_height();
+    vector<uint64_t> __search_query(const QueryNode &node);
+    vector<uint64_t> __evaluate_query(const QueryNode &node, uint64_t height);
+    vector<uint64_t> __filter_query(const QueryNode &node, const vector<uint64_t> &candidates);
+    vector<uint64_t> __filter_term(const QueryNode &node, const vector<uint64_t> &candidates);
 };
 
 #endif
@@ -0,0 +1,108 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+// FIFO queue between two pipeline stages holding at most capacity items.
+// Producers either block while it is full (Push) or get refused (TryPush),
+// so a full pipeline pushes back on whoever feeds it. Close() wakes the
+// consumer, which drains what is left and then sees Pop() fail.
+template<class T>
+class BoundedQueue
+{
+public:
+    BoundedQueue(size_t capacity) {
+        mCapacity = capacity < 1 ? 1 : capacity;
+        mClosed = false;
+    }
+
+    bool TryPush(const T &item) {
+        {
+            unique_lock<mutex> lock(mMutex);
+            if (mClosed || mItems.size() >= mCapacity) {
+                return false;
+            }
+            mItems.push_back(item);
+        }
+        mNotEmpty.notify_one();
+        return true;
+    }
+
+    bool Push(const T &item) {
+        {
+            unique_lock<mutex> lock(mMutex);
+            while (!mClosed && mItems.size() >= mCapacity) {
+                mNotFull.wait(lock);
+            }
+            if (mClosed) {
+                return false;
+            }
+            mItems.push_back(item);
+        }
+        mNotEmpty.notify_one();
+        return true;
+    }
+
+    // blocks until an item is there, false once closed and drained
+    bool Pop(T &item) {
+        {
+            unique_lock<mutex> lock(mMutex);
+            while (!mClosed && mItems.empty()) {
+                mNotEmpty.wait(lock);
+            }
+            if (mItems.empty()) {
+                return false;
+            }
+            item = mItems.front();
+            mItems.pop_front();
+        }
+        mNotFull.notify_one();
+        return true;
+    }
+
+    bool TryPop(T &item) {
+        {
+            unique_lock<mutex> lock(mMutex);
+            if (mItems.empty()) {
+                return false;
+            }
+            item = mItems.front();
+            mItems.pop_front();
+        }
+        mNotFull.notify_one();
+        return true;
+    }
+
+    void Close() {
+        {
+            unique_lock<mutex> lock(mMutex);
+            mClosed = true;
+        }
+        mNotEmpty.notify_all();
+        mNotFull.notify_all();
+    }
+
+    bool Full() {
+        unique_lock<mutex> lock(mMutex);
+        return mItems.size() >= mCapacity;
+    }
+
+    size_t size() {
+        unique_lock<mutex> lock(mMutex);
+        return mItems.size();
+    }
+
+private:
+    deque<T> mItems;
+    size_t mCapacity;
+    bool mClosed;
+    mutex mMutex;
+    condition_variable mNotEmpty;
+    condition_variable mNotFull;
+};
+
+#endif
@@ -1,8 +1,19 @@
 #include "agent.h"
 
-int main() {
+int main(int argc, char** argv) {
+    bool gen_params = false;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--gen-params") {
+            gen_params = true;
+        }
+        else {
+            cout << "usage: test_agent [--gen-params]" << endl;
+            return 0;
+        }
+    }
+
     Agent* agent = new Agent("../agent_storage/agent_info",
-            "../agent_storage/Contract_Chain");
+            "../agent_storage/Contract_Chain", gen_params);
     agent->serve();
     delete(agent);
 //    agent.test();
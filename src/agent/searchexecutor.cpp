@@ -0,0 +1,145 @@
+#include "searchexecutor.h"
+
+#include <algorithm>
+
+#include "peks/pbcpool.h"
+
+// smallest chunk of trapdoors worth scheduling on its own
+#define SEARCH_MIN_CHUNK 64
+// chunks per thread, so faster workers can steal from slower ones
+#define SEARCH_CHUNKS_PER_THREAD 8
+
+SearchExecutor::SearchExecutor() {
+}
+
+void SearchExecutor::setNumThreads(size_t num_threads) {
+    if (num_threads <= 1) {
+        mPool.reset();
+    }
+    else {
+        mPool.reset(new ThreadPool(num_threads));
+    }
+}
+
+size_t SearchExecutor::getNumThreads() {
+    return mPool ? mPool->getNumThreads() : 1;
+}
+
+// Runs fn(lo, hi) over [begin, end) in chunks of at most grain items on
+// the scan pool, or at once on the calling thread without one. Lets other
+// pairing-heavy work, such as making trapdoors, use the same cores.
+void SearchExecutor::ParallelFor(uint64_t begin, uint64_t end, uint64_t grain,
+                                 function<void(uint64_t, uint64_t)> fn) {
+    if (!mPool || end - begin <= grain) {
+        if (begin < end) {
+            fn(begin, end);
+        }
+    }
+    else {
+        mPool->ParallelFor(begin, end, grain, [&fn](size_t worker, uint64_t lo, uint64_t hi) {
+            fn(lo, hi);
+        });
+    }
+    __reset_pool();
+}
+
+// Blocks freed during a scan collect on the free lists of the calling
+// thread, which also receives the frees of the worker query copies, so
+// they are released after every query. Workers keep their bounded lists
+// for the next one.
+void SearchExecutor::__reset_pool() {
+    if (pbc_pool_installed()) {
+        pbc_pool_trim();
+    }
+}
+
+// Returns the positions p in [0, count) whose trapdoor_at(p, scratch)
+// matches the query, in ascending order. scratch is an element owned by
+// the thread running the test that trapdoor_at may load the trapdoor into.
+template<class TrapdoorAt>
+vector<uint64_t> SearchExecutor::__scan(PeksQuery &query, TrapdoorAt trapdoor_at,
+                                        uint64_t count, Pairing &pairing) {
+    vector<uint64_t> matches;
+    if (!mPool || count < 2 * SEARCH_MIN_CHUNK) {
+        Element scratch;
+        for (uint64_t i = 0; i < count; i++) {
+            if (query.Test(trapdoor_at(i, scratch), pairing)) {
+                matches.push_back(i);
+            }
+        }
+        __reset_pool();
+        return matches;
+    }
+
+    size_t num_threads = mPool->getNumThreads();
+    uint64_t grain = max((uint64_t)SEARCH_MIN_CHUNK,
+                         count / (num_threads * SEARCH_CHUNKS_PER_THREAD));
+
+    // per-worker query copies are made the first time a worker runs a chunk
+    vector<PeksQuery> worker_queries(num_threads);
+    vector<Element> worker_scratch(num_threads);
+    vector<vector<uint64_t>> worker_matches(num_threads);
+
+    mPool->ParallelFor(0, count, grain, [&](size_t worker, uint64_t lo, uint64_t hi) {
+        if (!worker_queries[worker].isInitialized()) {
+            worker_queries[worker].CopyFrom(query, pairing);
+        }
+        for (uint64_t i = lo; i < hi; i++) {
+            if (worker_queries[worker].Test(trapdoor_at(i, worker_scratch[worker]), pairing)) {
+                worker_matches[worker].push_back(i);
+            }
+        }
+    });
+
+    for (size_t i = 0; i < num_threads; i++) {
+        matches.insert(matches.end(), worker_matches[i].begin(), worker_matches[i].end());
+    }
+    sort(matches.begin(), matches.end());
+    __reset_pool();
+    return matches;
+}
+
+// Returns the indices of the trapdoors in [0, count) matching the query,
+// in ascending order.
+vector<uint64_t> SearchExecutor::Scan(PeksQuery &query, Element *trapdoors,
+                                      uint64_t count, Pairing &pairing) {
+    return __scan(query, [trapdoors](uint64_t i, Element &scratch) -> Element& {
+        return trapdoors[i];
+    }, count, pairing);
+}
+
+// Scans only trapdoors[indices[0]] .. trapdoors[indices[count - 1]] and
+// returns the positions in indices that match, in ascending order.
+vector<uint64_t> SearchExecutor::Scan(PeksQuery &query, Element *trapdoors, const uint64_t *indices,
+                                      uint64_t count, Pairing &pairing) {
+    return __scan(query, [trapdoors, indices](uint64_t i, Element &scratch) -> Element& {
+        return trapdoors[indices[i]];
+    }, count, pairing);
+}
+
+static Element& __load_trapdoor(const TrapdoorStore &store, uint64_t id, Element &scratch,
+                                Pairing &pairing) {
+    if (!scratch.isInitialized()) {
+        scratch.initG1(pairing);
+    }
+    scratch.fromBytes(store.get(id));
+    return scratch;
+}
+
+// Scans the trapdoors [begin, begin + count) of the store and returns the
+// positions after begin that match, in ascending order.
+vector<uint64_t> SearchExecutor::Scan(PeksQuery &query, const TrapdoorStore &store, uint64_t begin,
+                                      uint64_t count, Pairing &pairing) {
+    return __scan(query, [&store, begin, &pairing](uint64_t i, Element &scratch) -> Element& {
+        return __load_trapdoor(store, begin + i, scratch, pairing);
+    }, count, pairing);
+}
+
+// Scans the trapdoors indices[0] .. indices[count - 1] of the store and
+// returns the positions in indices that match, in ascending order.
+vector<uint64_t> SearchExecutor::Scan(PeksQuery &query, const TrapdoorStore &store, const uint64_t *indices,
+                                      uint64_t count, Pairing &pairing) {
+    return __scan(query, [&store, indices, &pairing](uint64_t i, Element &scratch) -> Element& {
+        return __load_trapdoor(store, indices[i], scratch, pairing);
+    }, count, pairing);
+}
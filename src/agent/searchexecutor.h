@@ -0,0 +1,46 @@
+#ifndef SEARCHEXECUTOR_H
+#define SEARCHEXECUTOR_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+#include "peks/pbcwrapper.h"
+#include "threadpool/threadpool.h"
+#include "trapdoorstore.h"
+
+using namespace std;
+
+// Scans a trapdoor array or store with one PEKS query on a work-stealing
+// pool. Every worker tests with its own copy of the query, so no PBC element
+// that is written during a test is shared between threads. Copies of an
+// executor share its pool.
+class SearchExecutor
+{
+public:
+    SearchExecutor();
+    void setNumThreads(size_t num_threads);
+    size_t getNumThreads();
+    vector<uint64_t> Scan(PeksQuery &query, Element *trapdoors,
+                          uint64_t count, Pairing &pairing);
+    vector<uint64_t> Scan(PeksQuery &query, Element *trapdoors, const uint64_t *indices,
+                          uint64_t count, Pairing &pairing);
+    vector<uint64_t> Scan(PeksQuery &query, const TrapdoorStore &store, uint64_t begin,
+                          uint64_t count, Pairing &pairing);
+    vector<uint64_t> Scan(PeksQuery &query, const TrapdoorStore &store, const uint64_t *indices,
+                          uint64_t count, Pairing &pairing);
+    void ParallelFor(uint64_t begin, uint64_t end, uint64_t grain,
+                     function<void(uint64_t, uint64_t)> fn);
+
+private:
+    shared_ptr<ThreadPool> mPool;
+
+    template<class TrapdoorAt>
+    vector<uint64_t> __scan(PeksQuery &query, TrapdoorAt trapdoor_at,
+                            uint64_t count, Pairing &pairing);
+
+    void __reset_pool();
+};
+
+#endif
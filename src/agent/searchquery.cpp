@@ -0,0 +1,160 @@
+#include "searchquery.h"
+
+#include <cctype>
+#include <stdexcept>
+
+// Recursive descent over the tokens of a query:
+//   or   := and ("OR" and)*
+//   and  := not ("AND" not)*
+//   not  := "NOT" not | "(" or ")" | term
+// Text in double quotes is taken literally, so a quoted token is never an
+// operator and is not split at a = inside the quotes.
+class QueryParser
+{
+public:
+    QueryParser(const string &text, bool (*is_field)(const string &field_name))
+        : mPos(0), mDepth(0), mIsField(is_field) {
+        QueryToken token;
+        bool in_token = false;
+        bool in_quotes = false;
+        for (size_t i = 0; i <= text.size(); i++) {
+            if (i == text.size() && in_quotes) {
+                throw invalid_argument("Missing \" in query");
+            }
+            char c = i < text.size() ? text[i] : ' ';
+            if (c == '"') {
+                in_token = true;
+                if (!in_quotes && token.literal_from == string::npos) {
+                    token.literal_from = token.text.size();
+                }
+                in_quotes = !in_quotes;
+            }
+            else if (!in_quotes && (isspace((unsigned char)c) || c == '(' || c == ')')) {
+                if (in_token) {
+                    mTokens.push_back(token);
+                    token = QueryToken();
+                    in_token = false;
+                }
+                if (c == '(' || c == ')') {
+                    mTokens.push_back(QueryToken(string(1, c)));
+                }
+            }
+            else {
+                in_token = true;
+                token.text += c;
+            }
+        }
+    }
+
+    QueryNode Parse() {
+        QueryNode root = __or();
+        if (mPos != mTokens.size()) {
+            throw invalid_argument("Unexpected " + mTokens[mPos].text + " in query");
+        }
+        return root;
+    }
+
+private:
+    struct QueryToken {
+        string text;
+        // where the first quoted text starts, npos when there is none
+        size_t literal_from;
+
+        QueryToken(string text = "") : text(text), literal_from(string::npos) {}
+        bool is(const string &op) const {
+            return literal_from == string::npos && text == op;
+        }
+    };
+
+    vector<QueryToken> mTokens;
+    size_t mPos;
+    // NOTs and parentheses around the current token
+    int mDepth;
+    bool (*mIsField)(const string &field_name);
+
+    bool __accept(const string &token) {
+        if (mPos < mTokens.size() && mTokens[mPos].is(token)) {
+            mPos++;
+            return true;
+        }
+        return false;
+    }
+
+    void __enter() {
+        if (++mDepth > QUERY_MAX_DEPTH) {
+            throw invalid_argument("Query nested too deeply");
+        }
+    }
+
+    // a run of one operator becomes a single node with every operand
+    QueryNode __binary(int type, const string &op, QueryNode (QueryParser::*operand)()) {
+        QueryNode first = (this->*operand)();
+        if (mPos >= mTokens.size() || !mTokens[mPos].is(op)) {
+            return first;
+        }
+        QueryNode node;
+        node.type = type;
+        node.children.push_back(first);
+        while (__accept(op)) {
+            node.children.push_back((this->*operand)());
+        }
+        return node;
+    }
+
+    QueryNode __or() {
+        return __binary(QUERY_OR, "OR", &QueryParser::__and);
+    }
+
+    QueryNode __and() {
+        return __binary(QUERY_AND, "AND", &QueryParser::__not);
+    }
+
+    QueryNode __not() {
+        if (mPos >= mTokens.size()) {
+            throw invalid_argument("Query ends where a keyword is expected");
+        }
+        QueryNode node;
+        if (__accept("NOT")) {
+            __enter();
+            node.type = QUERY_NOT;
+            node.children.push_back(__not());
+            mDepth--;
+            return node;
+        }
+        if (__accept("(")) {
+            __enter();
+            node = __or();
+            if (!__accept(")")) {
+                throw invalid_argument("Missing ) in query");
+            }
+            mDepth--;
+            return node;
+        }
+
+        const QueryToken &token = mTokens[mPos];
+        if (token.is(")") || token.is("AND") || token.is("OR")) {
+            throw invalid_argument("Unexpected " + token.text + " in query");
+        }
+        mPos++;
+        node.type = QUERY_TERM;
+        // only a known field name before the quotes scopes a term, any
+        // other = belongs to the keyword
+        size_t eq = token.text.find('=');
+        if (eq != string::npos && eq < token.literal_from && mIsField(token.text.substr(0, eq))) {
+            node.field = token.text.substr(0, eq);
+            node.keyword = token.text.substr(eq + 1);
+        }
+        else {
+            node.keyword = token.text;
+        }
+        if (node.keyword.empty()) {
+            throw invalid_argument("Empty keyword in query");
+        }
+        return node;
+    }
+};
+
+QueryNode ParseSearchQuery(const string &text, bool (*is_field)(const string &field_name)) {
+    QueryParser parser(text, is_field);
+    return parser.Parse();
+}
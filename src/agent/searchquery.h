@@ -0,0 +1,35 @@
+#ifndef SEARCHQUERY_H
+#define SEARCHQUERY_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define QUERY_TERM 0
+#define QUERY_AND 1
+#define QUERY_OR 2
+#define QUERY_NOT 3
+
+// NOTs and parentheses a query may nest, which bounds the recursion of
+// the parser and of everything walking the parsed tree
+#define QUERY_MAX_DEPTH 64
+
+// Boolean search over keywords. A term is "keyword" or "field=keyword";
+// terms combine with NOT, AND and OR (binding in that order) and
+// parentheses, e.g. "buyer=0x111 AND (drug OR NOT bread)". Double quotes
+// make a keyword literal, e.g. "\"OR\"" or "product=\"a=b\"".
+struct QueryNode {
+    int type;
+    string keyword;
+    // contract field of a term, empty for any field
+    string field;
+    vector<QueryNode> children;
+};
+
+// Throws invalid_argument if text is not a well-formed query or nests
+// deeper than QUERY_MAX_DEPTH. Text before the first = of a term is only
+// taken as its field when is_field knows it.
+QueryNode ParseSearchQuery(const string &text, bool (*is_field)(const string &field_name));
+
+#endif
@@ -0,0 +1,91 @@
+#include "searchresultcache.h"
+
+SearchResultCache::SearchResultCache() {
+    mCapacityBytes = 0;
+    mBytes = 0;
+    mHits = 0;
+    mMisses = 0;
+}
+
+SearchResultCache::SearchResultCache(size_t capacity_bytes) {
+    mCapacityBytes = capacity_bytes;
+    mBytes = 0;
+    mHits = 0;
+    mMisses = 0;
+}
+
+void SearchResultCache::setCapacity(size_t capacity_bytes) {
+    mCapacityBytes = capacity_bytes;
+    __evict();
+}
+
+// approximate footprint of one entry: the keyword twice (list and map),
+// both id vectors, the list node, the hash node and the vector headers
+size_t SearchResultCache::__entry_bytes(const string &keyword, const SearchResult &result) {
+    return 2 * keyword.size()
+           + (result.transaction_ids.size() + result.matches.size()) * sizeof(uint64_t)
+           + sizeof(Entry) + sizeof(list<Entry>::iterator) + 4 * sizeof(void*);
+}
+
+bool SearchResultCache::Get(const string &keyword, SearchResult &result) {
+    unordered_map<string, list<Entry>::iterator>::iterator it = mEntryMap.find(keyword);
+    if (it == mEntryMap.end()) {
+        mMisses++;
+        return false;
+    }
+    // move to the front as the most recently used
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    result = it->second->second;
+    mHits++;
+    return true;
+}
+
+// Looks keyword up without counting a hit or miss or touching its recency
+bool SearchResultCache::Contains(const string &keyword) const {
+    return mEntryMap.find(keyword) != mEntryMap.end();
+}
+
+// Replaces the result stored for keyword, if any
+void SearchResultCache::Put(const string &keyword, const SearchResult &result) {
+    unordered_map<string, list<Entry>::iterator>::iterator it = mEntryMap.find(keyword);
+    if (it != mEntryMap.end()) {
+        __erase(it->second);
+    }
+    size_t entry_bytes = __entry_bytes(keyword, result);
+    if (entry_bytes > mCapacityBytes) {
+        return;
+    }
+    mEntries.push_front(Entry(keyword, result));
+    mEntryMap.insert(pair<string, list<Entry>::iterator>(keyword, mEntries.begin()));
+    mBytes += entry_bytes;
+    __evict();
+}
+
+void SearchResultCache::__erase(list<Entry>::iterator it) {
+    mBytes -= __entry_bytes(it->first, it->second);
+    mEntryMap.erase(it->first);
+    mEntries.erase(it);
+}
+
+void SearchResultCache::__evict() {
+    while (mBytes > mCapacityBytes && !mEntries.empty()) {
+        __erase(--mEntries.end());
+    }
+}
+
+uint64_t SearchResultCache::getHits() {
+    return mHits;
+}
+
+uint64_t SearchResultCache::getMisses() {
+    return mMisses;
+}
+
+double SearchResultCache::getHitRatio() {
+    uint64_t lookups = mHits + mMisses;
+    return lookups == 0 ? 0 : (double)mHits / lookups;
+}
+
+size_t SearchResultCache::getBytes() {
+    return mBytes;
+}
@@ -0,0 +1,55 @@
+#ifndef SEARCHRESULTCACHE_H
+#define SEARCHRESULTCACHE_H
+
+#include <list>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+using namespace std;
+
+// Result of one keyword search together with its watermarks: the first
+// vocabulary_size trapdoors were tested and matches holds the ones that
+// matched, and transaction_ids covers every transaction below height.
+// A repeated search only tests the trapdoors added since and collects the
+// transactions at or above height from the posting lists of the matches.
+struct SearchResult {
+    vector<uint64_t> transaction_ids;
+    vector<uint64_t> matches;
+    uint64_t vocabulary_size;
+    uint64_t height;
+
+    SearchResult() : vocabulary_size(0), height(0) {}
+};
+
+// Bounded LRU cache from keyword to its last search result
+class SearchResultCache
+{
+public:
+    SearchResultCache();
+    SearchResultCache(size_t capacity_bytes);
+    void setCapacity(size_t capacity_bytes);
+    bool Get(const string &keyword, SearchResult &result);
+    bool Contains(const string &keyword) const;
+    void Put(const string &keyword, const SearchResult &result);
+    uint64_t getHits();
+    uint64_t getMisses();
+    double getHitRatio();
+    size_t getBytes();
+
+private:
+    typedef pair<string, SearchResult> Entry;
+    list<Entry> mEntries;
+    unordered_map<string, list<Entry>::iterator> mEntryMap;
+    size_t mCapacityBytes;
+    size_t mBytes;
+    uint64_t mHits;
+    uint64_t mMisses;
+
+    static size_t __entry_bytes(const string &keyword, const SearchResult &result);
+    void __erase(list<Entry>::iterator it);
+    void __evict();
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "tokenindex.h"
+
+#include <string.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+TokenIndex::TokenIndex() {
+    memset(mKey, 0, sizeof(mKey));
+}
+
+void TokenIndex::setKey(const unsigned char key[SHA256_DIGEST_LENGTH]) {
+    memcpy(mKey, key, sizeof(mKey));
+}
+
+// HMAC over one byte naming the scope (0 for any field, field + 1
+// otherwise) followed by the word. field is negative for any field.
+string TokenIndex::__token(const string &word, int field) {
+    string message(1, (char)(field < 0 ? 0 : field + 1));
+    message += word;
+    unsigned char token[SHA256_DIGEST_LENGTH];
+    unsigned int token_len = 0;
+    HMAC(EVP_sha256(), mKey, sizeof(mKey), (const unsigned char*)message.data(), message.size(),
+         token, &token_len);
+    return string((char*)token, token_len);
+}
+
+void TokenIndex::__add(uint64_t transaction_id, const string &token) {
+    vector<uint64_t> &postings = mPostings[token];
+    if (postings.empty() || postings.back() != transaction_id) {
+        postings.push_back(transaction_id);
+    }
+}
+
+void TokenIndex::Add(uint64_t transaction_id, const string &word, int field) {
+    __add(transaction_id, __token(word, -1));
+    __add(transaction_id, __token(word, field));
+}
+
+// Returns the transactions containing word in field, or in any field if
+// field is negative, in ascending order
+vector<uint64_t> TokenIndex::Lookup(const string &word, int field) {
+    unordered_map<string, vector<uint64_t>>::iterator it = mPostings.find(__token(word, field));
+    if (it == mPostings.end()) {
+        return vector<uint64_t>();
+    }
+    return it->second;
+}
+
+size_t TokenIndex::getNumTokens() {
+    return mPostings.size();
+}
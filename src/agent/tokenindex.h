@@ -0,0 +1,37 @@
+#ifndef TOKENINDEX_H
+#define TOKENINDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <openssl/sha.h>
+
+using namespace std;
+
+// Inverted index from a keyed token of every word to the transactions
+// containing it, for deployments that search without PEKS. Tokens are
+// HMAC-SHA256 of the word under a key derived from the agent key, so a
+// search is one HMAC and one hash table lookup instead of a pairing per
+// distinct trapdoor. Every word is indexed under a token of its own and
+// one scoped to the contract field it came from, so field-scoped lookups
+// are as cheap as plain ones. Transactions must be added in ascending
+// order.
+class TokenIndex
+{
+public:
+    TokenIndex();
+    void setKey(const unsigned char key[SHA256_DIGEST_LENGTH]);
+    void Add(uint64_t transaction_id, const string &word, int field);
+    vector<uint64_t> Lookup(const string &word, int field);
+    size_t getNumTokens();
+
+private:
+    unsigned char mKey[SHA256_DIGEST_LENGTH];
+    unordered_map<string, vector<uint64_t>> mPostings;
+
+    string __token(const string &word, int field);
+    void __add(uint64_t transaction_id, const string &token);
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "trapdoorcache.h"
+
+TrapdoorCache::TrapdoorCache() {
+    mCapacityBytes = 0;
+    mBytes = 0;
+    mHits = 0;
+    mMisses = 0;
+}
+
+TrapdoorCache::TrapdoorCache(size_t capacity_bytes) {
+    mCapacityBytes = capacity_bytes;
+    mBytes = 0;
+    mHits = 0;
+    mMisses = 0;
+}
+
+void TrapdoorCache::setCapacity(size_t capacity_bytes) {
+    mCapacityBytes = capacity_bytes;
+    __evict();
+}
+
+// approximate footprint of one entry: key and value twice (list and map)
+// plus the list node, the hash node and the vector headers
+size_t TrapdoorCache::__entry_bytes(const string &digest, const vector<unsigned char> &trapdoor_bytes) {
+    return 2 * digest.size() + trapdoor_bytes.size() + sizeof(Entry)
+           + sizeof(list<Entry>::iterator) + 4 * sizeof(void*);
+}
+
+bool TrapdoorCache::Get(const string &digest, vector<unsigned char> &trapdoor_bytes) {
+    unordered_map<string, list<Entry>::iterator>::iterator it = mEntryMap.find(digest);
+    if (it == mEntryMap.end()) {
+        mMisses++;
+        return false;
+    }
+    // move to the front as the most recently used
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    trapdoor_bytes = it->second->second;
+    mHits++;
+    return true;
+}
+
+void TrapdoorCache::Put(const string &digest, const vector<unsigned char> &trapdoor_bytes) {
+    size_t entry_bytes = __entry_bytes(digest, trapdoor_bytes);
+    if (entry_bytes > mCapacityBytes || mEntryMap.find(digest) != mEntryMap.end()) {
+        return;
+    }
+    mEntries.push_front(Entry(digest, trapdoor_bytes));
+    mEntryMap.insert(pair<string, list<Entry>::iterator>(digest, mEntries.begin()));
+    mBytes += entry_bytes;
+    __evict();
+}
+
+void TrapdoorCache::__evict() {
+    while (mBytes > mCapacityBytes && !mEntries.empty()) {
+        Entry &entry = mEntries.back();
+        mBytes -= __entry_bytes(entry.first, entry.second);
+        mEntryMap.erase(entry.first);
+        mEntries.pop_back();
+    }
+}
+
+uint64_t TrapdoorCache::getHits() {
+    return mHits;
+}
+
+uint64_t TrapdoorCache::getMisses() {
+    return mMisses;
+}
+
+size_t TrapdoorCache::getBytes() {
+    return mBytes;
+}
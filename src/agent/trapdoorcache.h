@@ -0,0 +1,39 @@
+#ifndef TRAPDOORCACHE_H
+#define TRAPDOORCACHE_H
+
+#include <list>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+using namespace std;
+
+// Bounded LRU cache from the SHA-512 digest of a word to the serialized
+// trapdoor of that word, so ingestion only exponentiates novel words.
+class TrapdoorCache
+{
+public:
+    TrapdoorCache();
+    TrapdoorCache(size_t capacity_bytes);
+    void setCapacity(size_t capacity_bytes);
+    bool Get(const string &digest, vector<unsigned char> &trapdoor_bytes);
+    void Put(const string &digest, const vector<unsigned char> &trapdoor_bytes);
+    uint64_t getHits();
+    uint64_t getMisses();
+    size_t getBytes();
+
+private:
+    typedef pair<string, vector<unsigned char>> Entry;
+    list<Entry> mEntries;
+    unordered_map<string, list<Entry>::iterator> mEntryMap;
+    size_t mCapacityBytes;
+    size_t mBytes;
+    uint64_t mHits;
+    uint64_t mMisses;
+
+    static size_t __entry_bytes(const string &digest, const vector<unsigned char> &trapdoor_bytes);
+    void __evict();
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include "trapdoorindexfile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TRAPDOOR_INDEX_MAGIC "NCTI"
+#define TRAPDOOR_INDEX_VERSION 2
+// oldest version still readable
+#define TRAPDOOR_INDEX_MIN_VERSION 1
+#define TRAPDOOR_INDEX_INIT_CAPACITY 1024
+#define TRAPDOOR_INDEX_INIT_TRAPDOOR_CAPACITY 16384
+
+TrapdoorIndexFile::TrapdoorIndexFile() {
+    mFd = -1;
+    mMap = NULL;
+    mMapSize = 0;
+    mHeader = NULL;
+    mOffsets = NULL;
+    mTrapdoors = NULL;
+}
+
+TrapdoorIndexFile::~TrapdoorIndexFile() {
+    Close();
+}
+
+// the mapping and descriptor move with the object, the source is left closed
+TrapdoorIndexFile::TrapdoorIndexFile(TrapdoorIndexFile &&other) : TrapdoorIndexFile() {
+    *this = std::move(other);
+}
+
+TrapdoorIndexFile& TrapdoorIndexFile::operator=(TrapdoorIndexFile &&other) {
+    if (this != &other) {
+        Close();
+        mPath = std::move(other.mPath);
+        mFd = other.mFd;
+        mMap = other.mMap;
+        mMapSize = other.mMapSize;
+        mHeader = other.mHeader;
+        mOffsets = other.mOffsets;
+        mTrapdoors = other.mTrapdoors;
+        other.mFd = -1;
+        other.mMap = NULL;
+        other.mMapSize = 0;
+        other.mHeader = NULL;
+        other.mOffsets = NULL;
+        other.mTrapdoors = NULL;
+    }
+    return *this;
+}
+
+size_t TrapdoorIndexFile::__file_size(uint64_t capacity, uint64_t trapdoor_capacity, uint32_t element_size) {
+    return sizeof(TrapdoorIndexHeader) + (capacity + 1) * sizeof(uint64_t)
+           + trapdoor_capacity * element_size;
+}
+
+// flush the pages covering [ptr, ptr + len) of the mapping to disk
+static void __sync_range(void *ptr, size_t len) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)ptr & ~(page_size - 1);
+    msync((void*)begin, (uintptr_t)ptr + len - begin, MS_SYNC);
+}
+
+bool TrapdoorIndexFile::__map(int fd, size_t size) {
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    mFd = fd;
+    mMap = (unsigned char*)map;
+    mMapSize = size;
+    mHeader = (TrapdoorIndexHeader*)mMap;
+    mOffsets = (uint64_t*)(mMap + sizeof(TrapdoorIndexHeader));
+    mTrapdoors = mMap + sizeof(TrapdoorIndexHeader) + (mHeader->capacity + 1) * sizeof(uint64_t);
+    return true;
+}
+
+void TrapdoorIndexFile::__unmap() {
+    if (mMap != NULL) {
+        munmap(mMap, mMapSize);
+    }
+    if (mFd >= 0) {
+        close(mFd);
+    }
+    mFd = -1;
+    mMap = NULL;
+    mMapSize = 0;
+    mHeader = NULL;
+    mOffsets = NULL;
+    mTrapdoors = NULL;
+}
+
+// The element size and flags are left for the caller to check against
+// how it makes trapdoors.
+bool TrapdoorIndexFile::Open(string path, const unsigned char *param_hash,
+                             const unsigned char *key_id) {
+    Close();
+    int fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TrapdoorIndexHeader)
+            || !__map(fd, st.st_size)) {
+        close(fd);
+        return false;
+    }
+    mPath = path;
+
+    // only trust an index made with the same parameters and key
+    if (memcmp(mHeader->magic, TRAPDOOR_INDEX_MAGIC, 4) != 0
+            || mHeader->version < TRAPDOOR_INDEX_MIN_VERSION
+            || mHeader->version > TRAPDOOR_INDEX_VERSION
+            || (mHeader->version == 1 && mHeader->flags != 0)
+            || (mHeader->flags & ~TRAPDOOR_INDEX_KNOWN_FLAGS) != 0
+            || memcmp(mHeader->param_hash, param_hash, SHA256_DIGEST_LENGTH) != 0
+            || memcmp(mHeader->key_id, key_id, SHA256_DIGEST_LENGTH) != 0
+            || mHeader->element_size == 0
+            || mHeader->count > mHeader->capacity
+            || mHeader->trapdoor_count > mHeader->trapdoor_capacity
+            // bounded first, so the size below cannot overflow
+            || mHeader->capacity >= mMapSize / sizeof(uint64_t)
+            || mHeader->trapdoor_capacity > mMapSize / mHeader->element_size
+            || mMapSize < __file_size(mHeader->capacity, mHeader->trapdoor_capacity,
+                                      mHeader->element_size)
+            || !__valid_offsets()) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+// A torn or corrupt offsets table would point getTrapdoors() outside the
+// mapping: the ranges have to start at 0, never go back, and end at the
+// trapdoor count of the header
+bool TrapdoorIndexFile::__valid_offsets() {
+    if (mOffsets[0] != 0 || mOffsets[mHeader->count] != mHeader->trapdoor_count) {
+        return false;
+    }
+    for (uint64_t i = 0; i < mHeader->count; i++) {
+        if (mOffsets[i + 1] < mOffsets[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TrapdoorIndexFile::Create(string path, const unsigned char *param_hash,
+                               const unsigned char *key_id, uint32_t element_size, uint32_t flags) {
+    Close();
+    TrapdoorIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRAPDOOR_INDEX_MAGIC, 4);
+    header.version = TRAPDOOR_INDEX_VERSION;
+    memcpy(header.param_hash, param_hash, SHA256_DIGEST_LENGTH);
+    memcpy(header.key_id, key_id, SHA256_DIGEST_LENGTH);
+    header.element_size = element_size;
+    header.flags = flags;
+    header.capacity = TRAPDOOR_INDEX_INIT_CAPACITY;
+    header.trapdoor_capacity = TRAPDOOR_INDEX_INIT_TRAPDOOR_CAPACITY;
+
+    // build the empty index aside and move it in place in one step
+    string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t size = __file_size(header.capacity, header.trapdoor_capacity, element_size);
+    uint64_t first_offset = 0;
+    if (ftruncate(fd, size) != 0
+            || pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)
+            || pwrite(fd, &first_offset, sizeof(first_offset), sizeof(header)) != (ssize_t)sizeof(first_offset)
+            || fsync(fd) != 0
+            || rename(tmp_path.c_str(), path.c_str()) != 0
+            || !__map(fd, size)) {
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    mPath = path;
+    return true;
+}
+
+void TrapdoorIndexFile::Close() {
+    __unmap();
+    mPath = "";
+}
+
+bool TrapdoorIndexFile::__grow(uint64_t capacity, uint64_t trapdoor_capacity) {
+    uint32_t element_size = mHeader->element_size;
+    string tmp_path = mPath + ".tmp";
+    int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t size = __file_size(capacity, trapdoor_capacity, element_size);
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    // copy header, offsets and trapdoors into the larger regions
+    unsigned char *new_map = (unsigned char*)map;
+    TrapdoorIndexHeader *header = (TrapdoorIndexHeader*)new_map;
+    memcpy(header, mHeader, sizeof(TrapdoorIndexHeader));
+    header->capacity = capacity;
+    header->trapdoor_capacity = trapdoor_capacity;
+    memcpy(new_map + sizeof(TrapdoorIndexHeader), mOffsets,
+           (mHeader->count + 1) * sizeof(uint64_t));
+    memcpy(new_map + sizeof(TrapdoorIndexHeader) + (capacity + 1) * sizeof(uint64_t),
+           mTrapdoors, mHeader->trapdoor_count * element_size);
+    munmap(map, size);
+
+    if (fsync(fd) != 0 || rename(tmp_path.c_str(), mPath.c_str()) != 0) {
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    string path = mPath;
+    __unmap();
+    mPath = path;
+    return __map(fd, size);
+}
+
+bool TrapdoorIndexFile::Append(uint64_t transaction_id, const vector<vector<unsigned char>> &trapdoor_list) {
+    return AppendBatch(transaction_id, &trapdoor_list, 1);
+}
+
+// Appends the trapdoors of transactions first_transaction_id ..
+// first_transaction_id + num_transactions - 1 with one grow and one sync
+// of each region, so a batch costs about as much disk work as a contract.
+// The batch has to start at getCount(): after a failed append every later
+// one fails too, so the missing transactions stay at or past getCount()
+// and are encrypted again on the next start.
+bool TrapdoorIndexFile::AppendBatch(uint64_t first_transaction_id,
+                                    const vector<vector<unsigned char>> *trapdoor_lists,
+                                    size_t num_transactions) {
+    if (mMap == NULL || first_transaction_id != mHeader->count || num_transactions == 0) {
+        return false;
+    }
+    uint32_t element_size = mHeader->element_size;
+    uint64_t num_trapdoors = 0;
+    for (size_t t = 0; t < num_transactions; t++) {
+        for (size_t i = 0; i < trapdoor_lists[t].size(); i++) {
+            if (trapdoor_lists[t][i].size() != element_size) {
+                return false;
+            }
+        }
+        num_trapdoors += trapdoor_lists[t].size();
+    }
+
+    uint64_t count = first_transaction_id + num_transactions;
+    uint64_t trapdoor_count = mHeader->trapdoor_count + num_trapdoors;
+    if (count > mHeader->capacity || trapdoor_count > mHeader->trapdoor_capacity) {
+        uint64_t capacity = mHeader->capacity;
+        uint64_t trapdoor_capacity = mHeader->trapdoor_capacity;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        while (trapdoor_capacity < trapdoor_count) {
+            trapdoor_capacity *= 2;
+        }
+        if (!__grow(capacity, trapdoor_capacity)) {
+            return false;
+        }
+    }
+
+    unsigned char *dst = mTrapdoors + mHeader->trapdoor_count * element_size;
+    uint64_t offset = mHeader->trapdoor_count;
+    for (size_t t = 0; t < num_transactions; t++) {
+        for (size_t i = 0; i < trapdoor_lists[t].size(); i++) {
+            memcpy(mTrapdoors + (offset + i) * element_size, trapdoor_lists[t][i].data(), element_size);
+        }
+        offset += trapdoor_lists[t].size();
+        mOffsets[first_transaction_id + t + 1] = offset;
+    }
+
+    // the data has to reach the disk before the header counts it
+    __sync_range(dst, num_trapdoors * element_size);
+    __sync_range(mOffsets + mHeader->count + 1, (count - mHeader->count) * sizeof(uint64_t));
+    mHeader->trapdoor_count = trapdoor_count;
+    mHeader->count = count;
+    __sync_range(mHeader, sizeof(TrapdoorIndexHeader));
+    return true;
+}
+
+uint64_t TrapdoorIndexFile::getCount() {
+    return mMap == NULL ? 0 : mHeader->count;
+}
+
+uint32_t TrapdoorIndexFile::getElementSize() {
+    return mMap == NULL ? 0 : mHeader->element_size;
+}
+
+uint32_t TrapdoorIndexFile::getFlags() {
+    return mMap == NULL ? 0 : mHeader->flags;
+}
+
+const unsigned char* TrapdoorIndexFile::getTrapdoors(uint64_t transaction_id, uint64_t &num_trapdoors) {
+    if (mMap == NULL || transaction_id >= mHeader->count) {
+        num_trapdoors = 0;
+        return NULL;
+    }
+    num_trapdoors = mOffsets[transaction_id + 1] - mOffsets[transaction_id];
+    return mTrapdoors + mOffsets[transaction_id] * mHeader->element_size;
+}
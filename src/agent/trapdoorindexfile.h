@@ -0,0 +1,77 @@
+#ifndef TRAPDOORINDEXFILE_H
+#define TRAPDOORINDEXFILE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <openssl/sha.h>
+
+using namespace std;
+
+// On-disk layout of the trapdoor index, integers in host byte order:
+//   header | offsets[capacity + 1] | trapdoors[trapdoor_capacity]
+// offsets[i] .. offsets[i + 1] is the range of trapdoors of transaction i
+// and every trapdoor takes element_size bytes, so the whole file can be
+// mapped and read in place. Regions are preallocated and doubled when
+// full, so appending a contract never rewrites what is already stored.
+// flags record how the trapdoors were made; version 1 files predate them
+// and read as 0.
+struct TrapdoorIndexHeader {
+    char magic[4];
+    uint32_t version;
+    unsigned char param_hash[SHA256_DIGEST_LENGTH];
+    unsigned char key_id[SHA256_DIGEST_LENGTH];
+    uint32_t element_size;
+    uint32_t flags;
+    uint64_t count;
+    uint64_t trapdoor_count;
+    uint64_t capacity;
+    uint64_t trapdoor_capacity;
+};
+
+// H1 hashed the raw word digest (PEKS_HASH_BINARY) instead of its hex text
+#define TRAPDOOR_INDEX_FLAG_BINARY_H1 0x1
+// trapdoors are element_to_bytes_compressed points; only earlier versions
+// wrote these, the agent rewrites them with the full encoding on load
+#define TRAPDOOR_INDEX_FLAG_COMPRESSED_G1 0x2
+#define TRAPDOOR_INDEX_KNOWN_FLAGS (TRAPDOOR_INDEX_FLAG_BINARY_H1 | TRAPDOOR_INDEX_FLAG_COMPRESSED_G1)
+
+class TrapdoorIndexFile
+{
+public:
+    TrapdoorIndexFile();
+    ~TrapdoorIndexFile();
+    TrapdoorIndexFile(TrapdoorIndexFile &&other);
+    TrapdoorIndexFile& operator=(TrapdoorIndexFile &&other);
+    TrapdoorIndexFile(const TrapdoorIndexFile&) = delete;
+    TrapdoorIndexFile& operator=(const TrapdoorIndexFile&) = delete;
+    bool Open(string path, const unsigned char *param_hash,
+              const unsigned char *key_id);
+    bool Create(string path, const unsigned char *param_hash,
+                const unsigned char *key_id, uint32_t element_size, uint32_t flags);
+    void Close();
+    bool Append(uint64_t transaction_id, const vector<vector<unsigned char>> &trapdoor_list);
+    bool AppendBatch(uint64_t first_transaction_id, const vector<vector<unsigned char>> *trapdoor_lists,
+                     size_t num_transactions);
+    uint64_t getCount();
+    uint32_t getElementSize();
+    uint32_t getFlags();
+    const unsigned char* getTrapdoors(uint64_t transaction_id, uint64_t &num_trapdoors);
+
+private:
+    string mPath;
+    int mFd;
+    unsigned char *mMap;
+    size_t mMapSize;
+    TrapdoorIndexHeader *mHeader;
+    uint64_t *mOffsets;
+    unsigned char *mTrapdoors;
+
+    bool __map(int fd, size_t size);
+    void __unmap();
+    bool __grow(uint64_t capacity, uint64_t trapdoor_capacity);
+    bool __valid_offsets();
+    static size_t __file_size(uint64_t capacity, uint64_t trapdoor_capacity, uint32_t element_size);
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "trapdoorstore.h"
+
+#include <string.h>
+
+TrapdoorStore::TrapdoorStore() : mSize(0) {
+    mElementSize = 0;
+    mBytes = 0;
+    memset(mSegments, 0, sizeof(mSegments));
+}
+
+TrapdoorStore::~TrapdoorStore() {
+    __clear();
+}
+
+TrapdoorStore::TrapdoorStore(TrapdoorStore &&other) : mSize(other.mSize.load()) {
+    mElementSize = other.mElementSize;
+    mBytes = other.mBytes;
+    memcpy(mSegments, other.mSegments, sizeof(mSegments));
+    memset(other.mSegments, 0, sizeof(other.mSegments));
+    other.mSize = 0;
+    other.mBytes = 0;
+}
+
+TrapdoorStore& TrapdoorStore::operator=(TrapdoorStore &&other) {
+    if (this != &other) {
+        __clear();
+        mElementSize = other.mElementSize;
+        mBytes = other.mBytes;
+        mSize = other.mSize.load();
+        memcpy(mSegments, other.mSegments, sizeof(mSegments));
+        memset(other.mSegments, 0, sizeof(other.mSegments));
+        other.mSize = 0;
+        other.mBytes = 0;
+    }
+    return *this;
+}
+
+void TrapdoorStore::__clear() {
+    for (int i = 0; i < TRAPDOOR_STORE_MAX_SEGMENTS; i++) {
+        delete[] mSegments[i];
+        mSegments[i] = NULL;
+    }
+    mSize = 0;
+    mBytes = 0;
+}
+
+// Segment k starts at trapdoor TRAPDOOR_STORE_SEGMENT * (2^k - 1)
+int TrapdoorStore::__locate(uint64_t id, uint64_t &offset) {
+    uint64_t q = id / TRAPDOOR_STORE_SEGMENT + 1;
+    int segment = 63 - __builtin_clzll(q);
+    offset = id - (uint64_t)TRAPDOOR_STORE_SEGMENT * ((1ULL << segment) - 1);
+    return segment;
+}
+
+// Drops the stored trapdoors if the size changes
+void TrapdoorStore::setElementSize(uint32_t element_size) {
+    if (element_size != mElementSize) {
+        __clear();
+    }
+    mElementSize = element_size;
+}
+
+uint32_t TrapdoorStore::getElementSize() const {
+    return mElementSize;
+}
+
+// Copies element_size bytes from trapdoor and returns the id of the copy
+uint64_t TrapdoorStore::Append(const unsigned char *trapdoor) {
+    uint64_t id = mSize.load(memory_order_relaxed);
+    uint64_t offset;
+    int segment = __locate(id, offset);
+    if (mSegments[segment] == NULL) {
+        size_t segment_bytes = ((size_t)TRAPDOOR_STORE_SEGMENT << segment) * mElementSize;
+        mSegments[segment] = new unsigned char[segment_bytes];
+        mBytes += segment_bytes;
+    }
+    memcpy(mSegments[segment] + offset * mElementSize, trapdoor, mElementSize);
+    mSize.store(id + 1, memory_order_release);
+    return id;
+}
+
+const unsigned char *TrapdoorStore::get(uint64_t id) const {
+    uint64_t offset;
+    int segment = __locate(id, offset);
+    return mSegments[segment] + offset * mElementSize;
+}
+
+uint64_t TrapdoorStore::size() const {
+    return mSize.load(memory_order_acquire);
+}
+
+size_t TrapdoorStore::getBytes() const {
+    return mBytes;
+}
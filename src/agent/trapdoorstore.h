@@ -0,0 +1,48 @@
+#ifndef TRAPDOORSTORE_H
+#define TRAPDOORSTORE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace std;
+
+// trapdoors in the first segment; segment k holds this many << k
+#define TRAPDOOR_STORE_SEGMENT 1024
+#define TRAPDOOR_STORE_MAX_SEGMENTS 48
+
+// Distinct trapdoors of the chain as their full element_to_bytes
+// encodings, element_size bytes each, back to back in a few large
+// segments. A scan walks them in order and loads each trapdoor into a
+// reusable scratch element right before pairing it, instead of keeping
+// one PBC element per trapdoor with its coordinates in separate heap
+// blocks. Segments never move once allocated, so one thread may append
+// while others read the trapdoors below a size() they loaded; Append
+// publishes the new size only after the bytes are written.
+class TrapdoorStore
+{
+public:
+    TrapdoorStore();
+    ~TrapdoorStore();
+    TrapdoorStore(TrapdoorStore &&other);
+    TrapdoorStore& operator=(TrapdoorStore &&other);
+    TrapdoorStore(const TrapdoorStore&) = delete;
+    TrapdoorStore& operator=(const TrapdoorStore&) = delete;
+    void setElementSize(uint32_t element_size);
+    uint32_t getElementSize() const;
+    uint64_t Append(const unsigned char *trapdoor);
+    const unsigned char *get(uint64_t id) const;
+    uint64_t size() const;
+    size_t getBytes() const;
+
+private:
+    uint32_t mElementSize;
+    unsigned char *mSegments[TRAPDOOR_STORE_MAX_SEGMENTS];
+    atomic<uint64_t> mSize;
+    size_t mBytes;
+
+    void __clear();
+    static int __locate(uint64_t id, uint64_t &offset);
+};
+
+#endif
@@ -2,16 +2,25 @@
 
 using namespace std;
 
+// wait before sending a contract the agent refused again
+#define AGENT_RETRY_US 100000
+
 Approver::Approver() {
     mDecision = false;
     mDecision4Buyer = "";
     mApproveRequestor = "";
+    mRoundLock.reset(new mutex());
+    mHttpThreads = 1;
+    mComputeThreads = 1;
 }
 
 Approver::Approver(string approver_info_filepath, string approver_list_filepath, string agent_info_filepath) {
     mDecision = false;
     mDecision4Buyer = "";
     mApproveRequestor = "";
+    mRoundLock.reset(new mutex());
+    mHttpThreads = 1;
+    mComputeThreads = 1;
     Load_Files(approver_info_filepath, approver_list_filepath, agent_info_filepath);
 }
 
@@ -24,6 +33,14 @@ void Approver::Load_Files(string approver_info_filepath, string approver_list_fi
         mSelfAddr = approver_map["ADDR"];
         mSelfIPAddr = approver_map["IP_ADDR"];
         mSelfOpenPort = approver_map["OPENPORT"];
+        // a round keeps its state in the approver, so neither requests
+        // nor rounds may run side by side
+        if (approver_map["HTTP_THREADS"] != "" && stoul(approver_map["HTTP_THREADS"]) > 1) {
+            cout << "HTTP_THREADS above 1 is not supported by the approver, using 1" << endl;
+        }
+        if (approver_map["COMPUTE_THREADS"] != "" && stoul(approver_map["COMPUTE_THREADS"]) > 1) {
+            cout << "COMPUTE_THREADS above 1 is not supported by the approver, using 1" << endl;
+        }
     }
     else {
         cout << "Parsing Approver Info fails!" << endl;
@@ -52,7 +69,7 @@ void Approver::Load_Files(string approver_info_filepath, string approver_list_fi
                 prev_prefix = approver_prefix;
 
                 if (initialized) {
-                    this->mApproverList.push_back(approver_info);
+                    this->mApproverList.push_back(std::move(approver_info));
                 }
 
                 approver_info = Approver();
@@ -72,7 +89,7 @@ void Approver::Load_Files(string approver_info_filepath, string approver_list_fi
             }
         }
 
-        this->mApproverList.push_back(approver_info);
+        this->mApproverList.push_back(std::move(approver_info));
     }
     else {
         cout << "Parsing Seller Info fails!" << endl;
@@ -98,41 +115,52 @@ void Approver::__waitforContract(HttpServer& server) {
 
     cout << "Waiting for contracts......" << endl;
     server.resource["^/contract$"]["POST"] = [this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
-        try {
-            string recv_string = request->content.string();
-            stringstream iarchive_stream;
-            iarchive_stream << recv_string;
-            boost::archive::text_iarchive iarchive(iarchive_stream);
-            mContract = Contract();
-            iarchive >> mContract;
-            cout << "Received contract from buyer " << mContract.getBuyerAddr() << endl;
-            __sendApprovalRequest();
-
-            while(true) {
-                if (mDecision4Buyer != "") {
-                    break;
+        // the round waits for the other approvers and the agent, so it runs
+        // on the compute pool and answers the buyer from there
+        string recv_string = request->content.string();
+        mComputePool->Submit([this, response, recv_string](size_t) {
+            try {
+                stringstream iarchive_stream;
+                iarchive_stream << recv_string;
+                boost::archive::text_iarchive iarchive(iarchive_stream);
+                mContract = Contract();
+                iarchive >> mContract;
+                cout << "Received contract from buyer " << mContract.getBuyerAddr() << endl;
+                __sendApprovalRequest();
+
+                string decision4buyer;
+                while(true) {
+                    {
+                        lock_guard<mutex> lock(*mRoundLock);
+                        decision4buyer = mDecision4Buyer;
+                    }
+                    if (decision4buyer != "") {
+                        break;
+                    }
+                    usleep(1);
                 }
-                usleep(1);
-            }
-
-            string decision_str = "{\"decision\": \"";
-            decision_str += mDecision4Buyer + "\"}";
-            cout << "Send decision " << mDecision4Buyer << "back to buyer" << endl;
-            *response << "HTTP/1.1 200 OK\r\n"
-                      << "Content-Length: " << decision_str.length() << "\r\n\r\n"
-                      << decision_str;
-        }
-        catch(const exception &e) {
-          *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << strlen(e.what()) << "\r\n\r\n"
-                    << e.what();
-        }
 
-        mAllApproverDecisions.clear();
-        mDecision4Buyer = "";
-        mDecision = false;
-        //send contract to agent
-        __send_contract2agent();
+                string decision_str = "{\"decision\": \"";
+                decision_str += decision4buyer + "\"}";
+                cout << "Send decision " << decision4buyer << "back to buyer" << endl;
+                *response << "HTTP/1.1 200 OK\r\n"
+                          << "Content-Length: " << decision_str.length() << "\r\n\r\n"
+                          << decision_str;
+            }
+            catch(const exception &e) {
+              *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << strlen(e.what()) << "\r\n\r\n"
+                        << e.what();
+            }
 
+            {
+                lock_guard<mutex> lock(*mRoundLock);
+                mAllApproverDecisions.clear();
+                mDecision4Buyer = "";
+                mDecision = false;
+            }
+            //send contract to agent
+            __send_contract2agent();
+        });
     };
 
 
@@ -148,28 +176,35 @@ void Approver::__waitforApprovalRequest(HttpServer& server) {
               read_json(request->content, pt);
 
               string approver_addr = pt.get<string>("Approver_Addr");
-              for (int i = 0; i < mApproverList.size(); i++) {
-                  // legitimate approver
-                  approver_addr.erase(remove(approver_addr.begin(), approver_addr.end(), '\n'), approver_addr.end());
-                  if (approver_addr.find(mApproverList[i].getAddr()) != std::string::npos) {
-                      mApproveRequestor = approver_addr;
-                      mDecision = true;
-                      break;
+              {
+                  lock_guard<mutex> lock(*mRoundLock);
+                  for (int i = 0; i < mApproverList.size(); i++) {
+                      // legitimate approver
+                      approver_addr.erase(remove(approver_addr.begin(), approver_addr.end(), '\n'), approver_addr.end());
+                      if (approver_addr.find(mApproverList[i].getAddr()) != std::string::npos) {
+                          mApproveRequestor = approver_addr;
+                          mDecision = true;
+                          break;
+                      }
                   }
+                  mAllApproverDecisions.push_back(mDecision);
               }
-              mAllApproverDecisions.push_back(mDecision);
               this->__sendDecision2Others();
 
               thread check_concensus_thread([response, this] {
                   int approved_count = 0;
                   int deny_count = 0;
                   while (true) {
-                      if (mAllApproverDecisions.size() > 0
-                              && mAllApproverDecisions.size() >= mApproverList.size()-1) {
-                          break;
+                      {
+                          lock_guard<mutex> lock(*mRoundLock);
+                          if (mAllApproverDecisions.size() > 0
+                                  && mAllApproverDecisions.size() >= mApproverList.size()-1) {
+                              break;
+                          }
                       }
                       usleep(1);
                   }
+                  unique_lock<mutex> lock(*mRoundLock);
 
                   // get all the decisions, see if concensus. reply to the proofer and clear the decision stack
                  for (int i = 0; i < mAllApproverDecisions.size(); i++) {
@@ -193,6 +228,7 @@ void Approver::__waitforApprovalRequest(HttpServer& server) {
                  mApproveRequestor = "";
                  mAllApproverDecisions.clear();
                  mDecision = false;
+                 lock.unlock();
                  decision_str += "\"}";
 
                  *response << "HTTP/1.1 200 OK\r\n"
@@ -224,6 +260,7 @@ void Approver::__waitforOtherDecisions(HttpServer& server) {
                                       << "Content-Length: " << response_str.length() << "\r\n\r\n"
                                       << response_str;
 
+                lock_guard<mutex> lock(*mRoundLock);
                 if(other_des.find("true") != std::string::npos
                         || other_des.find("True") != std::string::npos) {
                     this->mAllApproverDecisions.push_back(true);
@@ -253,6 +290,7 @@ void Approver::__sendApprovalRequest() {
                         ptree pt;
                         read_json(response->content, pt);
                         string decision_str = pt.get<string>("Decision");
+                        lock_guard<mutex> lock(*mRoundLock);
                         mDecision4Buyer = decision_str;
                         cout << "The decision is " << decision_str << endl;
                     }
@@ -271,27 +309,46 @@ void Approver::__send_contract2agent() {
     boost::archive::text_oarchive archive(archive_stream);
     archive << mContract;
 
-    // send to the approver
-    HttpClient agent_client(mAgent.getIPAddr() + ":" + mAgent.getOpenPort());
-    agent_client.request("POST", "/contract", archive_stream.str(),
-                         [](shared_ptr<HttpClient::Response> response, const SimpleWeb::error_code &ec) {
-      });
-     agent_client.io_service->run();
+    // send to the agent, which answers 429 while its ingestion queue is
+    // full; the contract is sent again until it is acknowledged
+    bool queue_full = true;
+    while (queue_full) {
+        queue_full = false;
+        HttpClient agent_client(mAgent.getIPAddr() + ":" + mAgent.getOpenPort());
+        agent_client.request("POST", "/contract", archive_stream.str(),
+                             [&queue_full](shared_ptr<HttpClient::Response> response, const SimpleWeb::error_code &ec) {
+            if (!ec && response->status_code.compare(0, 3, "429") == 0) {
+                queue_full = true;
+            }
+          });
+        agent_client.io_service->run();
+        if (queue_full) {
+            usleep(AGENT_RETRY_US);
+        }
+    }
 }
 
 // send decision to other approvers
 void Approver::__sendDecision2Others() {
     // HttpClient* client_verifier[Verifier::mConsortiumNodeIPs.size()];
+    // the threads outlive the request, so they get the decision by value
+    bool decision;
+    string approve_requestor;
+    {
+        lock_guard<mutex> lock(*mRoundLock);
+        decision = mDecision;
+        approve_requestor = mApproveRequestor;
+    }
     for (int i = 0; i<mApproverList.size(); i++) {
         if (mApproverList[i].getAddr().find(mSelfAddr) != std::string::npos ||
-                mApproveRequestor.find(mApproverList[i].getAddr()) != std::string::npos) {
+                approve_requestor.find(mApproverList[i].getAddr()) != std::string::npos) {
             continue;
         }
         // skip self and the requestor
-        thread send_other_thread([i, this] {
+        thread send_other_thread([i, decision, this] {
 
             string decision_str = "{\"decision\": \"";
-            if (mDecision) {
+            if (decision) {
                 decision_str += "true\"}";
             }
             else {
@@ -310,8 +367,12 @@ void Approver::__sendDecision2Others() {
 }
 
 void Approver::serve() {
+    if (!mComputePool) {
+        mComputePool.reset(new ThreadPool(mComputeThreads));
+    }
     HttpServer server;
     server.config.port = stoi(mSelfOpenPort);
+    server.config.thread_pool_size = mHttpThreads;
     __waitforContract(server);
     __waitforApprovalRequest(server);
     __waitforOtherDecisions(server);
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/serialization/vector.hpp>
@@ -18,6 +20,7 @@
 #include "configparser/configparser.h"
 #include "contract/contract.h"
 #include "agent/agent.h"
+#include "threadpool/threadpool.h"
 
 using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
@@ -44,6 +47,13 @@ private:
     string mSelfOpenPort;
     string mSelfIPAddr;
     vector<Approver> mApproverList;
+    // both pinned to 1: Load_Files only warns about larger HTTP_THREADS
+    // and COMPUTE_THREADS, see mRoundLock
+    size_t mHttpThreads;
+    size_t mComputeThreads;
+    // started by serve(), runs the approval rounds so they do not hold up
+    // the I/O threads
+    unique_ptr<ThreadPool> mComputePool;
     void __waitforContract(HttpServer& serve);
     void __waitforApprovalRequest(HttpServer& server);
     void __waitforOtherDecisions(HttpServer& server);
@@ -51,6 +61,12 @@ private:
     void __sendApprovalRequest();
     void __sendDecision2Others();
     Contract mContract;
+    // One approval round at a time: the decisions of the other approvers
+    // carry no round, so every handler shares the state of the current
+    // one. The lock guards the decisions and the requestor, which the
+    // handlers, the round and the threads sending requests all touch;
+    // held by pointer so the approver stays movable
+    unique_ptr<mutex> mRoundLock;
     bool mDecision;
     string mDecision4Buyer;
     string mApproveRequestor;
@@ -0,0 +1,76 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "peks/pbcwrapper.h"
+#include "peks/pbcpool.h"
+
+using namespace std;
+
+// Counts the PBC and GMP allocations behind one Test() and one
+// TestPrepared() and times both with the size-class pool disabled
+// (every allocation goes to malloc) and enabled.
+
+static double elapsed_ms(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+static void report(string name, int num_tests, double ms) {
+    pbc_pool_stats stats;
+    pbc_pool_get_stats(&stats);
+    cout << name << "\t" << (double)stats.alloc_calls / num_tests
+         << "\t" << (double)stats.system_allocs / num_tests
+         << "\t" << ms * 1000.0 / num_tests << endl;
+}
+
+int main(int argc, char** argv) {
+    int num_trapdoors = 1000;
+    if(argc > 1) {
+        num_trapdoors = atoi(argv[1]);
+    }
+    if(num_trapdoors < 1) {
+        cout << "usage: bench_alloc [num_trapdoors]" << endl;
+        return 0;
+    }
+
+    // before the first PBC or GMP allocation
+    pbc_pool_install();
+
+    Pairing pairing;
+    KeyPair key;
+    pairing.Generate();
+    key.Generate(pairing);
+
+    vector<Element> trapdoors(num_trapdoors);
+    for(int i = 0; i < num_trapdoors; i++) {
+        trapdoors[i].initG1(pairing);
+        element_random(trapdoors[i]);
+    }
+    string keyword = "drug";
+    char* keyword_c = (char*) keyword.c_str();
+
+    cout << "path\tallocs/op\tmallocs/op\tus/op" << endl;
+    for(int enabled = 0; enabled <= 1; enabled++) {
+        string mode = enabled ? "pool" : "malloc";
+        pbc_pool_set_enabled(enabled);
+        pbc_pool_trim();
+
+        pbc_pool_reset_stats();
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for(int i = 0; i < num_trapdoors; i++) {
+            Test(keyword_c, (int)keyword.length(), key.pub(), trapdoors[i], pairing, PEKS_HASH_BINARY);
+        }
+        report("Test/" + mode, num_trapdoors, elapsed_ms(begin));
+
+        PeksQuery query;
+        query.Build(keyword, key, pairing);
+        pbc_pool_reset_stats();
+        begin = chrono::steady_clock::now();
+        for(int i = 0; i < num_trapdoors; i++) {
+            query.Test(trapdoors[i], pairing);
+        }
+        report("TestPrepared/" + mode, num_trapdoors, elapsed_ms(begin));
+    }
+    return 0;
+}
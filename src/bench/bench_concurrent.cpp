@@ -0,0 +1,169 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchagent.h"
+
+using namespace std;
+
+// Ingests contracts on one thread while others search the agent, the way
+// HTTP_THREADS > 1 serves them. Every result has to be the chain as of
+// some contract: all the matching transactions below a height and none
+// above it, never shrinking between two searches of the same thread.
+// Returns 1 on the first result that is not. With --pipeline contracts
+// are acknowledged once appended and indexed by the background pipeline,
+// and the mean ack latency and the number of refusals (429s) are printed.
+
+static double elapsed_ms(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+struct Search {
+    string name;
+    function<vector<uint64_t>(Agent&)> run;
+    function<bool(uint64_t)> matches;
+};
+
+// The height a result is the chain as of, or -1 when it is not a prefix
+// of the matching transactions
+static int64_t prefix_height(const vector<uint64_t> &ids, function<bool(uint64_t)> matches) {
+    uint64_t next = 0;
+    for(size_t i = 0; i < ids.size(); i++) {
+        while(next < ids[i]) {
+            if(matches(next++)) {
+                return -1;
+            }
+        }
+        if(!matches(next++)) {
+            return -1;
+        }
+    }
+    return next;
+}
+
+int main(int argc, char** argv) {
+    bool pipeline = false;
+    int num_contracts = 10000;
+    int num_threads = 4;
+    int arg = 1;
+    if(argc > arg && string(argv[arg]) == "--pipeline") {
+        pipeline = true;
+        arg++;
+    }
+    if(argc > arg) {
+        num_contracts = atoi(argv[arg]);
+    }
+    if(argc > arg + 1) {
+        num_threads = atoi(argv[arg + 1]);
+    }
+    if(num_contracts < 1 || num_threads < 1) {
+        cout << "usage: bench_concurrent [--pipeline] [num_contracts] [search_threads]" << endl;
+        return 0;
+    }
+
+    BenchAgentDir dir("bench_concurrent",
+                      // the search threads are the concurrency here
+                      "SEARCH_THREADS=1\nPBC_POOL=1\n");
+    if(!dir.ok()) {
+        return 1;
+    }
+
+    vector<Search> searches;
+    searches.push_back(Search{"product=drug",
+        [](Agent &agent) { return agent.SearchKeyword("drug", FIELD_PRODUCT); },
+        [](uint64_t id) { return id % 3 == 0; }});
+    searches.push_back(Search{"drug",
+        [](Agent &agent) { return agent.SearchKeyword("drug", FIELD_ANY); },
+        [](uint64_t id) { return id % 3 == 0; }});
+    searches.push_back(Search{"product=drug AND NOT buyer=0x100",
+        [](Agent &agent) { return agent.SearchQuery("product=drug AND NOT buyer=0x100"); },
+        [](uint64_t id) { return id % 3 == 0 && id % 16 != 0; }});
+
+    atomic<bool> ingesting(true);
+    atomic<bool> consistent(true);
+    atomic<uint64_t> num_searches(0);
+    double ingest_ms = 0;
+    double search_ms = 0;
+    double ack_ms = 0;
+    uint64_t num_refused = 0;
+    {
+        // keep the agent's messages out of the results; only one thread
+        // prints, the ingesting one or the trapdoor stage
+        streambuf *cout_buf = cout.rdbuf();
+        stringstream discard;
+        cout.rdbuf(discard.rdbuf());
+        Agent agent(dir.getAgentInfo(), dir.getChainDir());
+        if(pipeline) {
+            agent.StartPipeline();
+        }
+
+        vector<thread> searchers;
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for(int t = 0; t < num_threads; t++) {
+            searchers.push_back(thread([&, t]() {
+                vector<int64_t> heights(searches.size(), 0);
+                for(uint64_t i = t; consistent; i++) {
+                    // one more round of every search once ingestion is done
+                    bool last = !ingesting;
+                    for(size_t s = 0; s < searches.size(); s++) {
+                        Search &search = searches[(i + s) % searches.size()];
+                        vector<uint64_t> ids = search.run(agent);
+                        int64_t height = prefix_height(ids, search.matches);
+                        if(height < 0 || height < heights[(i + s) % searches.size()]) {
+                            cerr << search.name << ": " << ids.size() << " transactions are not the chain as of a contract"
+                                 << (height < 0 ? "" : " after a larger result") << endl;
+                            consistent = false;
+                            break;
+                        }
+                        heights[(i + s) % searches.size()] = height;
+                        num_searches++;
+                    }
+                    if(last) {
+                        break;
+                    }
+                }
+            }));
+        }
+
+        for(int i = 0; i < num_contracts && consistent; i++) {
+            if(!pipeline) {
+                agent.IngestContracts(vector<Contract>(1, synthetic_contract(i)));
+                continue;
+            }
+            chrono::steady_clock::time_point ack_begin = chrono::steady_clock::now();
+            uint64_t first_id;
+            while(!agent.EnqueueContracts(vector<Contract>(1, synthetic_contract(i)), first_id)) {
+                num_refused++;
+                this_thread::yield();
+                ack_begin = chrono::steady_clock::now();
+            }
+            ack_ms += elapsed_ms(ack_begin);
+        }
+        if(pipeline && consistent) {
+            agent.WaitIndexed(num_contracts);
+        }
+        ingest_ms = elapsed_ms(begin);
+        ingesting = false;
+        for(size_t t = 0; t < searchers.size(); t++) {
+            searchers[t].join();
+        }
+        search_ms = elapsed_ms(begin);
+        cout.rdbuf(cout_buf);
+    }
+
+    cout << "contracts\tingest ms\tcontracts/s\tsearch threads\tsearches\tsearches/s" << endl;
+    cout << num_contracts << "\t" << ingest_ms << "\t" << num_contracts * 1000.0 / ingest_ms << "\t"
+         << num_threads << "\t" << num_searches << "\t" << num_searches * 1000.0 / search_ms << endl;
+    if(pipeline) {
+        cout << "ack us\trefused" << endl;
+        cout << ack_ms * 1000.0 / num_contracts << "\t" << num_refused << endl;
+    }
+
+    return consistent ? 0 : 1;
+}
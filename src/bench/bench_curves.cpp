@@ -0,0 +1,98 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "peks/pbcwrapper.h"
+
+using namespace std;
+
+// Trapdoor, PEKS and Test latency and the size of a stored trapdoor on
+// every curve family the agent can be configured with (CURVE,
+// CURVE_RBITS and CURVE_QBITS in agent_info).
+
+static double elapsed_ms(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char** argv) {
+    int iterations = 100;
+    if(argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+    if(iterations < 1) {
+        cout << "usage: bench_curves [iterations]" << endl;
+        return 0;
+    }
+
+    struct {
+        const char *name;
+        int rbits;
+        int qbits;
+    } curves[] = {
+        {"A", 160, 512},
+        {"A", 224, 1024},
+        {"A1", 512, 0},
+        {"E", 160, 1024},
+        {"F", 160, 0},
+        {"F", 256, 0},
+    };
+
+    cout << "curve\trbits\tqbits\tsymmetric\tparams ms\ttrapdoor us\tpeks us\ttest us"
+         << "\ttrapdoor bytes\tcompressed bytes" << endl;
+    for(size_t c = 0; c < sizeof(curves) / sizeof(curves[0]); c++) {
+        peks_curve curve;
+        peks_curve_init(&curve, curves[c].name, curves[c].rbits, curves[c].qbits);
+
+        Pairing pairing;
+        KeyPair key;
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        pairing.Generate(&curve);
+        double params_ms = elapsed_ms(begin);
+        key.Generate(pairing);
+
+        // Trapdoor = H1(W)^α, including the hash of the word
+        vector<string> words;
+        for(int i = 0; i < iterations; i++) {
+            words.push_back("word" + to_string(i));
+        }
+        vector<Element> trapdoors(iterations);
+        unsigned char digest[SHA512_DIGEST_LENGTH];
+        begin = chrono::steady_clock::now();
+        for(int i = 0; i < iterations; i++) {
+            Element H1_W;
+            sha512_raw(words[i].c_str(), (int)words[i].length(), digest);
+            H1(H1_W, pairing, digest, PEKS_HASH_BINARY);
+            Trapdoor(trapdoors[i], pairing, key.priv(), H1_W);
+        }
+        double trapdoor_us = elapsed_ms(begin) * 1000.0 / iterations;
+
+        // query-side PEKS with the fixed-base tables, as a search builds it
+        begin = chrono::steady_clock::now();
+        for(int i = 0; i < iterations; i++) {
+            PeksQuery query;
+            query.Build(words[i], key, pairing);
+        }
+        double peks_us = elapsed_ms(begin) * 1000.0 / iterations;
+
+        PeksQuery query;
+        query.Build(words[0], key, pairing);
+        int matches = 0;
+        begin = chrono::steady_clock::now();
+        for(int i = 0; i < iterations; i++) {
+            matches += query.Test(trapdoors[i], pairing);
+        }
+        double test_us = elapsed_ms(begin) * 1000.0 / iterations;
+        if(matches != 1) {
+            cout << peks_curve_name(&curve) << ": expected 1 match, got " << matches << endl;
+            return 1;
+        }
+
+        cout << peks_curve_name(&curve) << "\t" << curve.rbits << "\t" << curve.qbits
+             << "\t" << (pairing_is_symmetric(pairing) ? "yes" : "no")
+             << "\t" << params_ms << "\t" << trapdoor_us << "\t" << peks_us << "\t" << test_us
+             << "\t" << pairing_length_in_bytes_G1(pairing)
+             << "\t" << pairing_length_in_bytes_compressed_G1(pairing) << endl;
+    }
+    return 0;
+}
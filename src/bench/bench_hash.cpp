@@ -0,0 +1,120 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "peks/peks.h"
+
+using namespace std;
+
+// Per-word cost of the hashing around the pairings: the SHA-512 digest
+// with sprintf and table hex encoding, H1 of the hex text against H1 of
+// the raw digest, and H2 over element_snprint text against H2 over
+// element_to_bytes.
+
+static double elapsed_ms(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+static void report(string name, int num_words, double ms) {
+    cout << name << "\t" << ms * 1000000.0 / num_words << "\t"
+         << num_words * 1000.0 / ms << endl;
+}
+
+// the digest encoding sha512() used before hex_encode()
+static void sha512_sprintf(const char *word, int word_size, char hashed_word[SHA512_DIGEST_LENGTH*2+1]) {
+    unsigned char digest[SHA512_DIGEST_LENGTH];
+    sha512_raw(word, word_size, digest);
+    for(int i = 0; i < SHA512_DIGEST_LENGTH; i++) {
+        sprintf(&hashed_word[i*2], "%02x", (unsigned int)digest[i]);
+    }
+}
+
+int main(int argc, char** argv) {
+    int num_words = 10000;
+    if(argc > 1) {
+        num_words = atoi(argv[1]);
+    }
+    if(num_words < 1) {
+        cout << "usage: bench_hash [num_words]" << endl;
+        return 0;
+    }
+
+    pbc_param_t param;
+    pairing_t pairing;
+    init_pbc_param_pairing(param, pairing);
+
+    vector<string> words;
+    for(int i = 0; i < num_words; i++) {
+        words.push_back("word" + to_string(i));
+    }
+    char hex[SHA512_DIGEST_LENGTH*2+1];
+    unsigned char digest[SHA512_DIGEST_LENGTH];
+
+    cout << "step\tns/word\twords/s" << endl;
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for(int i = 0; i < num_words; i++) {
+        sha512_sprintf(words[i].c_str(), (int)words[i].length(), hex);
+    }
+    report("sha512+sprintf", num_words, elapsed_ms(begin));
+
+    begin = chrono::steady_clock::now();
+    for(int i = 0; i < num_words; i++) {
+        sha512(words[i].c_str(), (int)words[i].length(), hex);
+    }
+    report("sha512+table", num_words, elapsed_ms(begin));
+
+    begin = chrono::steady_clock::now();
+    for(int i = 0; i < num_words; i++) {
+        sha512_raw(words[i].c_str(), (int)words[i].length(), digest);
+    }
+    report("sha512_raw", num_words, elapsed_ms(begin));
+
+    // H1 including the digest, as a trapdoor or query is made
+    for(int hash_format = PEKS_HASH_HEX; hash_format <= PEKS_HASH_BINARY; hash_format++) {
+        begin = chrono::steady_clock::now();
+        for(int i = 0; i < num_words; i++) {
+            element_t H1_W;
+            sha512_raw(words[i].c_str(), (int)words[i].length(), digest);
+            H1(H1_W, pairing, digest, hash_format);
+            element_clear(H1_W);
+        }
+        report(hash_format == PEKS_HASH_HEX ? "H1/hex" : "H1/binary", num_words, elapsed_ms(begin));
+    }
+
+    // H2 of random GT elements
+    element_t t;
+    element_init_GT(t, pairing);
+    int len_t = element_length_in_bytes(t);
+    vector<unsigned char> buffer(len_t);
+    vector<element_s> ts;
+    for(int i = 0; i < num_words; i++) {
+        element_t e;
+        element_init_GT(e, pairing);
+        element_random(e);
+        ts.push_back(*e);
+    }
+
+    begin = chrono::steady_clock::now();
+    for(int i = 0; i < num_words; i++) {
+        element_snprint((char*)buffer.data(), len_t, &ts[i]);
+        sha512((char*)buffer.data(), len_t, hex);
+    }
+    report("H2/snprint+hex", num_words, elapsed_ms(begin));
+
+    begin = chrono::steady_clock::now();
+    for(int i = 0; i < num_words; i++) {
+        element_to_bytes(buffer.data(), &ts[i]);
+        sha512_raw((char*)buffer.data(), len_t, digest);
+    }
+    report("H2/bytes+raw", num_words, elapsed_ms(begin));
+
+    for(int i = 0; i < num_words; i++) {
+        element_clear(&ts[i]);
+    }
+    element_clear(t);
+    pairing_clear(pairing);
+    pbc_param_clear(param);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "peks/peks.h"
+
+using namespace std;
+
+// Compares plain pairing_apply() against pairing_pp_apply() with the query
+// ciphertext A preprocessed once, the way a search scans stored trapdoors.
+
+// distinct trapdoor-like G1 points; larger scans cycle over them
+#define NUM_DISTINCT_POINTS 1000
+
+static double elapsed_ms(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char** argv) {
+    vector<int> scan_sizes;
+    for(int i = 1; i < argc; i++) {
+        scan_sizes.push_back(atoi(argv[i]));
+    }
+    if(scan_sizes.empty()) {
+        scan_sizes.push_back(1000);
+        scan_sizes.push_back(10000);
+        scan_sizes.push_back(100000);
+    }
+
+    pbc_param_t param;
+    pairing_t pairing;
+    init_pbc_param_pairing(param, pairing);
+
+    element_t A;
+    element_init_G1(A, pairing);
+    element_random(A);
+
+    vector<element_s> points;
+    for(int i = 0; i < NUM_DISTINCT_POINTS; i++) {
+        element_t Tw;
+        element_init_G1(Tw, pairing);
+        element_random(Tw);
+        points.push_back(*Tw);
+    }
+
+    element_t out;
+    element_init_GT(out, pairing);
+
+    cout << "trapdoors\tplain ms\tpp ms\tplain us/op\tpp us/op\tspeedup" << endl;
+    for(int n : scan_sizes) {
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for(int i = 0; i < n; i++) {
+            pairing_apply(out, &points[i % NUM_DISTINCT_POINTS], A, pairing);
+        }
+        double plain_ms = elapsed_ms(begin);
+
+        // the preprocessing is part of every search, so it is timed too
+        begin = chrono::steady_clock::now();
+        pairing_pp_t pp;
+        pairing_pp_init(pp, A, pairing);
+        for(int i = 0; i < n; i++) {
+            pairing_pp_apply(out, &points[i % NUM_DISTINCT_POINTS], pp);
+        }
+        pairing_pp_clear(pp);
+        double pp_ms = elapsed_ms(begin);
+
+        cout << n << "\t" << plain_ms << "\t" << pp_ms << "\t"
+             << plain_ms * 1000 / n << "\t" << pp_ms * 1000 / n << "\t"
+             << plain_ms / pp_ms << "x" << endl;
+    }
+
+    for(int i = 0; i < NUM_DISTINCT_POINTS; i++) {
+        element_clear(&points[i]);
+    }
+    element_clear(out);
+    element_clear(A);
+    pbc_param_clear(param);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "agent/searchexecutor.h"
+
+using namespace std;
+
+// Scans one keyword query over a trapdoor vocabulary with the agent's
+// SearchExecutor at 1, 2, 4, ... threads and reports the scaling.
+
+static double elapsed_ms(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char** argv) {
+    int num_trapdoors = 20000;
+    int max_threads = 32;
+    if(argc > 1) {
+        num_trapdoors = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        max_threads = atoi(argv[2]);
+    }
+    if(num_trapdoors < 1 || max_threads < 1) {
+        cout << "usage: bench_parallel_search [num_trapdoors] [max_threads]" << endl;
+        return 0;
+    }
+
+    Pairing pairing;
+    KeyPair key;
+    pairing.Generate();
+    key.Generate(pairing);
+
+    // random points cost the same to pair as real trapdoors
+    vector<Element> trapdoors(num_trapdoors);
+    for(int i = 0; i < num_trapdoors; i++) {
+        trapdoors[i].initG1(pairing);
+        element_random(trapdoors[i]);
+    }
+
+    PeksQuery query;
+    query.Build("drug", key, pairing);
+
+    double base_ms = 0;
+    cout << "threads\tms\ttrapdoors/s\tspeedup" << endl;
+    for(int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        SearchExecutor executor;
+        executor.setNumThreads(num_threads);
+
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        executor.Scan(query, trapdoors.data(), trapdoors.size(), pairing);
+        double ms = elapsed_ms(begin);
+        if(num_threads == 1) {
+            base_ms = ms;
+        }
+        cout << num_threads << "\t" << ms << "\t" << num_trapdoors * 1000.0 / ms
+             << "\t" << base_ms / ms << "x" << endl;
+    }
+    return 0;
+}
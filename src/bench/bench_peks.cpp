@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchagent.h"
+
+using namespace std;
+
+// Latency of every PEKS primitive and of the agent's ingestion and search
+// paths on synthetic data: mean ns/op, ops/s, p50/p99 and allocations per
+// op. Allocations are operator new calls plus the PBC and GMP allocations
+// counted by the pool. With --json the results are printed as one JSON
+// object, so runs before and after a change can be diffed.
+
+static atomic<uint64_t> num_new_calls(0);
+
+void *operator new(size_t size) {
+    num_new_calls.fetch_add(1, memory_order_relaxed);
+    void *p = malloc(size == 0 ? 1 : size);
+    if(p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+// stops the scan once limit transactions are found, as a search with a
+// limit does
+static vector<uint64_t> search_keyword_limit(Agent &agent, string keyword, uint64_t limit) {
+    uint64_t num_found = 0;
+    return agent.SearchKeyword(keyword, FIELD_ANY,
+        [&num_found, limit](const vector<uint64_t> &new_ids, uint64_t scanned, uint64_t total) {
+            num_found += new_ids.size();
+            return num_found < limit;
+        });
+}
+
+struct Result {
+    string name;
+    int iterations;
+    double mean_ns;
+    double p50_ns;
+    double p99_ns;
+    double allocs_per_op;
+};
+
+static uint64_t num_allocs() {
+    pbc_pool_stats stats;
+    pbc_pool_get_stats(&stats);
+    return num_new_calls.load(memory_order_relaxed) + stats.alloc_calls;
+}
+
+// Times op(0) .. op(iterations - 1) one by one. Ops leave their outputs
+// in slots prepared by the caller, so nothing but the op itself is timed.
+static Result run(string name, int iterations, function<void(int)> op) {
+    vector<double> samples(iterations);
+    uint64_t allocs_before = num_allocs();
+    for(int i = 0; i < iterations; i++) {
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        op(i);
+        samples[i] = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+    }
+    uint64_t allocs = num_allocs() - allocs_before;
+
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.mean_ns = 0;
+    for(int i = 0; i < iterations; i++) {
+        result.mean_ns += samples[i];
+    }
+    result.mean_ns /= iterations;
+    sort(samples.begin(), samples.end());
+    result.p50_ns = samples[iterations / 2];
+    result.p99_ns = samples[min(iterations - 1, iterations * 99 / 100)];
+    result.allocs_per_op = (double)allocs / iterations;
+    return result;
+}
+
+static void print_text(vector<Result> &results) {
+    cout << "op\titerations\tns/op\tops/s\tp50 ns\tp99 ns\tallocs/op" << endl;
+    for(size_t i = 0; i < results.size(); i++) {
+        Result &r = results[i];
+        cout << r.name << "\t" << r.iterations << "\t" << r.mean_ns << "\t" << 1e9 / r.mean_ns
+             << "\t" << r.p50_ns << "\t" << r.p99_ns << "\t" << r.allocs_per_op << endl;
+    }
+}
+
+static void print_json(vector<Result> &results) {
+    cout << "{\"benchmarks\": [";
+    for(size_t i = 0; i < results.size(); i++) {
+        Result &r = results[i];
+        cout << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+             << ", \"ns_per_op\": " << r.mean_ns << ", \"ops_per_sec\": " << 1e9 / r.mean_ns
+             << ", \"p50_ns\": " << r.p50_ns << ", \"p99_ns\": " << r.p99_ns
+             << ", \"allocs_per_op\": " << r.allocs_per_op << "}";
+    }
+    cout << "\n]}" << endl;
+}
+
+static void run_primitives(vector<Result> &results, int iterations) {
+    Pairing pairing;
+    KeyPair key_pair;
+    pairing.Generate();
+    key_pair.Generate(pairing);
+
+    vector<string> words;
+    for(int i = 0; i < iterations; i++) {
+        words.push_back("word" + to_string(i));
+    }
+    vector<vector<unsigned char>> digests(iterations, vector<unsigned char>(SHA512_DIGEST_LENGTH));
+    int nlogP = log2(mpz_get_d(pairing->r));
+    if(nlogP > SHA512_DIGEST_LENGTH * 8) {
+        nlogP = SHA512_DIGEST_LENGTH * 8;
+    }
+
+    results.push_back(run("sha512", iterations, [&](int i) {
+        sha512_raw(words[i].c_str(), (int)words[i].length(), digests[i].data());
+    }));
+
+    vector<Element> hashes(iterations);
+    for(int i = 0; i < iterations; i++) {
+        hashes[i].initG1(pairing);
+    }
+    results.push_back(run("element_from_hash", iterations, [&](int i) {
+        element_from_hash(hashes[i], digests[i].data(), SHA512_DIGEST_LENGTH);
+    }));
+
+    vector<key> keys(iterations);
+    results.push_back(run("KeyGen", iterations, [&](int i) {
+        KeyGen(&keys[i], pairing.param(), pairing);
+    }));
+    for(int i = 0; i < iterations; i++) {
+        element_clear(keys[i].priv);
+        element_clear(keys[i].pub.g);
+        element_clear(keys[i].pub.h);
+    }
+
+    vector<Element> trapdoors(iterations);
+    results.push_back(run("Trapdoor", iterations, [&](int i) {
+        Trapdoor(trapdoors[i], pairing, key_pair.priv(), hashes[i]);
+    }));
+
+    vector<peks> ciphertexts(iterations);
+    results.push_back(run("PEKS", iterations, [&](int i) {
+        PEKS(&ciphertexts[i], key_pair.pub(), pairing, hashes[i], nlogP);
+    }));
+    for(int i = 0; i < iterations; i++) {
+        element_clear(ciphertexts[i].A);
+    }
+
+    results.push_back(run("Test", iterations, [&](int i) {
+        Test((char*)words[i].c_str(), (int)words[i].length(), key_pair.pub(), trapdoors[i],
+             pairing, PEKS_HASH_BINARY);
+    }));
+
+    PeksQuery query;
+    query.Build(words[0], key_pair, pairing);
+    results.push_back(run("TestPrepared", iterations, [&](int i) {
+        query.Test(trapdoors[i], pairing);
+    }));
+}
+
+// contracts per batch in the __encrypt_contracts row
+#define INGEST_BATCH 16
+
+static void run_agent(vector<Result> &results, int num_contracts, int num_searches) {
+    BenchAgentDir dir("bench_peks",
+                      // one search thread, so the scan is counted on this thread
+                      "SEARCH_THREADS=1\nPBC_POOL=1\n"
+                      // full scans first, the result cache is enabled further down
+                      "SEARCH_CACHE_BYTES=0\n");
+    if(!dir.ok()) {
+        return;
+    }
+
+    {
+        // keep the agent's start-up messages out of the results
+        streambuf *cout_buf = cout.rdbuf();
+        stringstream discard;
+        cout.rdbuf(discard.rdbuf());
+        Agent agent(dir.getAgentInfo(), dir.getChainDir());
+        cout.rdbuf(cout_buf);
+
+        vector<Contract> contracts;
+        for(int i = 0; i < num_contracts; i++) {
+            contracts.push_back(synthetic_contract(i));
+        }
+        results.push_back(run("__encrypt_contract", num_contracts, [&](int i) {
+            agent.IndexContracts(vector<Contract>(1, contracts[i]));
+        }));
+        // a batch makes every novel trapdoor once (in parallel with more
+        // SEARCH_THREADS) and appends them to the index file at once; ns/op
+        // is per batch
+        int num_batches = max(1, num_contracts / INGEST_BATCH);
+        vector<vector<Contract>> batches(num_batches);
+        for(int i = 0; i < num_batches; i++) {
+            for(int j = 0; j < INGEST_BATCH; j++) {
+                batches[i].push_back(synthetic_contract(num_contracts + i * INGEST_BATCH + j));
+            }
+        }
+        results.push_back(run("__encrypt_contracts/" + to_string(INGEST_BATCH), num_batches, [&](int i) {
+            agent.IndexContracts(batches[i]);
+        }));
+        int next_id = num_contracts + num_batches * INGEST_BATCH;
+
+        vector<string> keywords;
+        keywords.push_back("drug");
+        keywords.push_back("0x100");
+        keywords.push_back("lot0");
+        keywords.push_back("missing");
+        results.push_back(run("__search_keyword", num_searches, [&](int i) {
+            agent.SearchKeyword(keywords[i % keywords.size()]);
+        }));
+        results.push_back(run("__search_keyword/buyer", num_searches, [&](int i) {
+            agent.SearchKeyword(keywords[1], FIELD_BUYER);
+        }));
+        // the scan in SEARCH_STREAM_SLICE slices, stopped after the first
+        // slice holding a match
+        results.push_back(run("__search_keyword/limit1", num_searches, [&](int i) {
+            search_keyword_limit(agent, keywords[0], 1);
+        }));
+        // one buyer column scan plus the candidates it leaves
+        results.push_back(run("__search_query/and", num_searches, [&](int i) {
+            agent.SearchQuery("buyer=0x100 AND drug");
+        }));
+
+        // repeated keywords with a contract ingested before every search,
+        // so each one extends its cached result by one contract
+        agent.setSearchCacheBytes(DEFAULT_SEARCH_CACHE_BYTES);
+        for(size_t i = 0; i < keywords.size(); i++) {
+            agent.SearchKeyword(keywords[i]);
+        }
+        results.push_back(run("__encrypt_contract+__search_keyword/cached", num_searches, [&](int i) {
+            agent.IndexContracts(vector<Contract>(1, synthetic_contract(next_id + i)));
+            agent.SearchKeyword(keywords[i % keywords.size()]);
+        }));
+    }
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    vector<int> counts;
+    counts.push_back(200);
+    counts.push_back(100);
+    counts.push_back(20);
+    size_t num_counts = 0;
+    for(int i = 1; i < argc; i++) {
+        if(string(argv[i]) == "--json") {
+            json = true;
+        }
+        else if(num_counts < counts.size()) {
+            counts[num_counts++] = atoi(argv[i]);
+        }
+        else {
+            counts[0] = 0;
+        }
+    }
+    if(counts[0] < 1 || counts[1] < 1 || counts[2] < 1) {
+        cout << "usage: bench_peks [--json] [iterations] [num_contracts] [num_searches]" << endl;
+        return 0;
+    }
+
+    // before the first PBC or GMP allocation, to count them
+    pbc_pool_install();
+
+    vector<Result> results;
+    run_primitives(results, counts[0]);
+    run_agent(results, counts[1], counts[2]);
+
+    if(json) {
+        print_json(results);
+    }
+    else {
+        print_text(results);
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "peks/peks.h"
+
+using namespace std;
+
+#define NUM_QUERIES 100
+
+// Compares the per-trapdoor cost of a keyword search done with Test(),
+// which rebuilds the query-side PEKS for every trapdoor (two pairings),
+// against PEKSQuery() once plus TestPrepared() per trapdoor (one pairing).
+
+static void gen_trapdoor(element_t Tw, pairing_t pairing, element_t alpha, string word) {
+    unsigned char hashedW[SHA512_DIGEST_LENGTH];
+    element_t H1_W1;
+    sha512_raw(word.c_str(), (int)word.length(), hashedW);
+    H1(H1_W1, pairing, hashedW, PEKS_HASH_BINARY);
+    Trapdoor(Tw, pairing, alpha, H1_W1);
+    element_clear(H1_W1);
+}
+
+static double elapsed_ms(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char** argv) {
+    int num_trapdoors = 1000;
+    if(argc > 1) {
+        num_trapdoors = atoi(argv[1]);
+    }
+    if(num_trapdoors < 1) {
+        cout << "usage: bench_search [num_trapdoors]" << endl;
+        return 0;
+    }
+
+    pbc_param_t param;
+    pairing_t pairing;
+    key key;
+    init_pbc_param_pairing(param, pairing);
+    KeyGen(&key, param, pairing);
+
+    // every 10th stored word is the keyword, the rest are distinct
+    string keyword = "drug";
+    vector<element_s> trapdoor_list;
+    for(int i = 0; i < num_trapdoors; i++) {
+        element_t Tw;
+        gen_trapdoor(Tw, pairing, key.priv, i % 10 == 0 ? keyword : "word" + to_string(i));
+        trapdoor_list.push_back(*Tw);
+    }
+    char* keyword_c = (char*) keyword.c_str();
+
+    int test_matches = 0;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for(int i = 0; i < num_trapdoors; i++) {
+        test_matches += Test(keyword_c, (int)strlen(keyword_c), &key.pub, &trapdoor_list[i],
+                             pairing, PEKS_HASH_BINARY);
+    }
+    double test_ms = elapsed_ms(begin);
+
+    int prepared_matches = 0;
+    begin = chrono::steady_clock::now();
+    peks_query query;
+    PEKSQuery(&query, keyword_c, (int)strlen(keyword_c), &key.pub, NULL, pairing, PEKS_HASH_BINARY);
+    for(int i = 0; i < num_trapdoors; i++) {
+        prepared_matches += TestPrepared(&query, &trapdoor_list[i], pairing);
+    }
+    peks_query_clear(&query);
+    double prepared_ms = elapsed_ms(begin);
+
+    // per-search fixed cost of building the query with and without the
+    // fixed-base tables of g and h
+    key_pp pp;
+    key_pp_init(&pp, &key.pub);
+    begin = chrono::steady_clock::now();
+    for(int i = 0; i < NUM_QUERIES; i++) {
+        PEKSQuery(&query, keyword_c, (int)strlen(keyword_c), &key.pub, NULL, pairing, PEKS_HASH_BINARY);
+        peks_query_clear(&query);
+    }
+    double query_us = elapsed_ms(begin) * 1000 / NUM_QUERIES;
+    begin = chrono::steady_clock::now();
+    for(int i = 0; i < NUM_QUERIES; i++) {
+        PEKSQuery(&query, keyword_c, (int)strlen(keyword_c), &key.pub, &pp, pairing, PEKS_HASH_BINARY);
+        peks_query_clear(&query);
+    }
+    double query_pp_us = elapsed_ms(begin) * 1000 / NUM_QUERIES;
+    key_pp_clear(&pp);
+
+    cout << "trapdoors: " << num_trapdoors << ", matches: " << test_matches
+         << "/" << prepared_matches << endl;
+    cout << "Test():          " << test_ms << " ms, "
+         << test_ms * 1000 / num_trapdoors << " us/trapdoor" << endl;
+    cout << "TestPrepared():  " << prepared_ms << " ms, "
+         << prepared_ms * 1000 / num_trapdoors << " us/trapdoor" << endl;
+    cout << "speedup: " << test_ms / prepared_ms << "x" << endl;
+    // what the code paths do by construction, not counted
+    cout << "expected pairings/trapdoor: Test() 2, TestPrepared() "
+         << (num_trapdoors + 1.0) / num_trapdoors << endl;
+    cout << "PEKSQuery():     " << query_us << " us, "
+         << query_pp_us << " us with fixed-base tables" << endl;
+
+    for(int i = 0; i < num_trapdoors; i++) {
+        element_clear(&trapdoor_list[i]);
+    }
+    pbc_param_clear(param);
+    return 0;
+}
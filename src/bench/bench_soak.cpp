@@ -0,0 +1,92 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "agent/searchexecutor.h"
+
+using namespace std;
+
+// Runs keyword searches back to back over a small trapdoor vocabulary the
+// way the agent does (one PeksQuery per search, scanned by the
+// SearchExecutor) and reports the resident set size every 10% of the
+// run. The RSS should stay flat once the allocator has warmed up; any
+// steady growth is a leak on the search path.
+
+static double elapsed_ms(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+static long rss_kb() {
+    long pages = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if(fp == NULL) {
+        return -1;
+    }
+    if(fscanf(fp, "%ld %ld", &pages, &resident) != 2) {
+        resident = -1;
+    }
+    fclose(fp);
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int main(int argc, char** argv) {
+    long num_searches = 1000000;
+    int num_trapdoors = 8;
+    int num_threads = 1;
+    if(argc > 1) {
+        num_searches = atol(argv[1]);
+    }
+    if(argc > 2) {
+        num_trapdoors = atoi(argv[2]);
+    }
+    if(argc > 3) {
+        num_threads = atoi(argv[3]);
+    }
+    if(num_searches < 1 || num_trapdoors < 1 || num_threads < 1) {
+        cout << "usage: bench_soak [num_searches] [num_trapdoors] [threads]" << endl;
+        return 0;
+    }
+
+    Pairing pairing;
+    KeyPair key;
+    pairing.Generate();
+    key.Generate(pairing);
+
+    // trapdoors of real words, so some searches match
+    vector<string> words;
+    vector<Element> trapdoors(num_trapdoors);
+    unsigned char hashedW[SHA512_DIGEST_LENGTH];
+    for(int i = 0; i < num_trapdoors; i++) {
+        words.push_back("word" + to_string(i));
+        sha512_raw(words[i].c_str(), (int)words[i].length(), hashedW);
+        Element H1_W;
+        H1(H1_W, pairing, hashedW, PEKS_HASH_BINARY);
+        Trapdoor(trapdoors[i], pairing, key.priv(), H1_W);
+    }
+
+    SearchExecutor executor;
+    executor.setNumThreads(num_threads);
+
+    long step = max(1L, num_searches / 10);
+    long matches = 0;
+    cout << "searches\tms\tsearches/s\trss_kb" << endl;
+    cout << 0 << "\t" << 0 << "\t" << 0 << "\t" << rss_kb() << endl;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for(long n = 1; n <= num_searches; n++) {
+        PeksQuery query;
+        query.Build(words[n % num_trapdoors], key, pairing);
+        matches += executor.Scan(query, trapdoors.data(), trapdoors.size(), pairing).size();
+        if(n % step == 0 || n == num_searches) {
+            double ms = elapsed_ms(begin);
+            cout << n << "\t" << ms << "\t" << n * 1000.0 / ms << "\t" << rss_kb() << endl;
+        }
+    }
+
+    if(matches != num_searches) {
+        cout << "expected " << num_searches << " matches, got " << matches << endl;
+        return 1;
+    }
+    return 0;
+}
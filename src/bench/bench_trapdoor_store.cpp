@@ -0,0 +1,105 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "agent/searchexecutor.h"
+#include "agent/trapdoorstore.h"
+
+using namespace std;
+
+// Scan throughput and memory per trapdoor of the two vocabulary layouts:
+// one PBC element per trapdoor (every element with its coordinates in
+// separate heap blocks) against the segmented TrapdoorStore, whose
+// trapdoors are loaded into scratch elements only when paired. Memory is
+// the growth of the resident set while a layout is filled.
+
+static double elapsed_ms(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+static long rss_kb() {
+    long pages = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if(fp == NULL) {
+        return -1;
+    }
+    if(fscanf(fp, "%ld %ld", &pages, &resident) != 2) {
+        resident = -1;
+    }
+    fclose(fp);
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int main(int argc, char** argv) {
+    int num_trapdoors = 10000;
+    int num_threads = 1;
+    if(argc > 1) {
+        num_trapdoors = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        num_threads = atoi(argv[2]);
+    }
+    if(num_trapdoors < 1 || num_threads < 1) {
+        cout << "usage: bench_trapdoor_store [num_trapdoors] [threads]" << endl;
+        return 0;
+    }
+
+    Pairing pairing;
+    KeyPair key;
+    pairing.Generate();
+    key.Generate(pairing);
+
+    // the same random points in both layouts; they cost the same to pair
+    // as real trapdoors
+    uint32_t element_size = pairing_length_in_bytes_G1(pairing);
+    vector<unsigned char> points((size_t)num_trapdoors * element_size);
+    {
+        Element point;
+        point.initG1(pairing);
+        for(int i = 0; i < num_trapdoors; i++) {
+            element_random(point);
+            element_to_bytes(points.data() + (size_t)i * element_size, point);
+        }
+    }
+
+    long rss_before = rss_kb();
+    vector<Element> elements(num_trapdoors);
+    for(int i = 0; i < num_trapdoors; i++) {
+        elements[i].initG1(pairing);
+        elements[i].fromBytes(points.data() + (size_t)i * element_size);
+    }
+    double elements_bytes = (rss_kb() - rss_before) * 1024.0 / num_trapdoors;
+
+    rss_before = rss_kb();
+    TrapdoorStore store;
+    store.setElementSize(element_size);
+    for(int i = 0; i < num_trapdoors; i++) {
+        store.Append(points.data() + (size_t)i * element_size);
+    }
+    double store_bytes = (rss_kb() - rss_before) * 1024.0 / num_trapdoors;
+
+    SearchExecutor executor;
+    executor.setNumThreads(num_threads);
+    PeksQuery query;
+    query.Build("drug", key, pairing);
+
+    cout << "layout\tbytes/trapdoor\tms\ttrapdoors/s" << endl;
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    size_t element_matches = executor.Scan(query, elements.data(), num_trapdoors, pairing).size();
+    double ms = elapsed_ms(begin);
+    cout << "vector<Element>\t" << elements_bytes << "\t" << ms << "\t" << num_trapdoors * 1000.0 / ms << endl;
+
+    begin = chrono::steady_clock::now();
+    size_t store_matches = executor.Scan(query, store, (uint64_t)0, num_trapdoors, pairing).size();
+    ms = elapsed_ms(begin);
+    cout << "TrapdoorStore\t" << store_bytes << "\t" << ms << "\t" << num_trapdoors * 1000.0 / ms << endl;
+
+    if(element_matches != store_matches) {
+        cout << "layouts disagree: " << element_matches << " and " << store_matches << " matches" << endl;
+        return 1;
+    }
+    return 0;
+}
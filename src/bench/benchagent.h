@@ -0,0 +1,90 @@
+#ifndef BENCHAGENT_H
+#define BENCHAGENT_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "agent/agent.h"
+
+using namespace std;
+
+// Synthetic chain and scratch agent directory shared by the benches that
+// drive a whole agent
+
+// a few buyers, sellers and products shared across the chain, plus one
+// word only contract i has
+static inline Contract synthetic_contract(int i) {
+    string buyer = "0x" + to_string(100 + i % 16);
+    string seller = "0x" + to_string(200 + i % 8);
+    string product = i % 3 == 0 ? "drug" : (i % 3 == 1 ? "bread" : "strawberry");
+    string description = "Bought some " + product + " lot" + to_string(i);
+    return Contract(i, buyer, seller, 100 + i % 50, 0, description, product);
+}
+
+// A temporary directory with an agent_info (plus the given lines), a
+// chain directory, and the parameters, key and trapdoor index the agent
+// makes there; all of it is removed again on destruction
+class BenchAgentDir
+{
+public:
+    BenchAgentDir(string name, string agent_info_lines) {
+        string dir_template = "/tmp/" + name + "XXXXXX";
+        if(mkdtemp(&dir_template[0]) == NULL) {
+            perror("Fail to create a temporary directory");
+            return;
+        }
+        mDir = dir_template;
+        mkdir(getChainDir().c_str(), 0700);
+        ofstream info(getAgentInfo());
+        info << "ADDR=0xabc\nIP_ADDR=127.0.0.1\nOPENPORT=7777\n"
+             << "PARAM_FILE=" << mDir << "/pairing.param\n"
+             << "KEY_FILE=" << mDir << "/agent.key\n"
+             << "TRAPDOOR_INDEX_FILE=" << mDir << "/trapdoor.index\n"
+             << agent_info_lines;
+    }
+
+    ~BenchAgentDir() {
+        if(mDir.empty()) {
+            return;
+        }
+        DIR *dir = opendir(getChainDir().c_str());
+        if(dir != NULL) {
+            struct dirent *ent;
+            while((ent = readdir(dir)) != NULL) {
+                string name = ent->d_name;
+                if(name != "." && name != "..") {
+                    unlink((getChainDir() + "/" + name).c_str());
+                }
+            }
+            closedir(dir);
+        }
+        unlink(getAgentInfo().c_str());
+        unlink((mDir + "/pairing.param").c_str());
+        unlink((mDir + "/agent.key").c_str());
+        unlink((mDir + "/trapdoor.index").c_str());
+        rmdir(getChainDir().c_str());
+        rmdir(mDir.c_str());
+    }
+
+    bool ok() {
+        return !mDir.empty();
+    }
+
+    string getAgentInfo() {
+        return mDir + "/agent_info";
+    }
+
+    string getChainDir() {
+        return mDir + "/Contract_Chain";
+    }
+
+private:
+    string mDir;
+};
+
+#endif
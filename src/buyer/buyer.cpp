@@ -98,7 +98,7 @@ void Buyer::Load_Info_File(string Buyer_Info_File, string Sell_List_File, string
                 prev_prefix = approver_prefix;
 
                 if (initialized) {
-                    this->mApproverList.push_back(approver_info);
+                    this->mApproverList.push_back(std::move(approver_info));
                 }
 
                 approver_info = Approver();
@@ -118,7 +118,7 @@ void Buyer::Load_Info_File(string Buyer_Info_File, string Sell_List_File, string
             }
         }
 
-        this->mApproverList.push_back(approver_info);
+        this->mApproverList.push_back(std::move(approver_info));
     }
     else {
         cout << "Approver List Info fails!" << endl;
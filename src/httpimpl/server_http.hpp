@@ -101,6 +101,12 @@ namespace SimpleWeb {
         });
       }
 
+      /// Closes the connection, cancelling a send that is still pending
+      void close() noexcept {
+        close_connection_after_response = true;
+        session->connection->close();
+      }
+
       /// Write directly to stream buffer using std::ostream::write
       void write(const char_type *ptr, std::streamsize n) {
         std::ostream::write(ptr, n);
@@ -0,0 +1,184 @@
+/*
+ * pbcpool.cpp
+ */
+
+#include "pbcpool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <gmp.h>
+#include <pbc/pbc.h>
+
+/* Usable sizes 16, 32, ..., 2048 bytes are pooled, larger blocks always
+ * come from the system. At most POOL_MAX_CACHED blocks of one class stay
+ * on a thread's list, the rest are freed. */
+#define POOL_NUM_CLASSES 8
+#define POOL_MIN_SIZE 16
+#define POOL_MAX_SIZE (POOL_MIN_SIZE << (POOL_NUM_CLASSES - 1))
+#define POOL_MAX_CACHED 1024
+/* keeps the block behind the header aligned like malloc's */
+#define POOL_HEADER_SIZE 16
+
+typedef struct pool_block_s {
+	struct pool_block_s *next;
+}pool_block;
+
+/* Blocks are plain malloc blocks with their capacity in front, so one
+ * freed on another thread can simply join that thread's list */
+struct pool_cache {
+	pool_block *free_list[POOL_NUM_CLASSES];
+	size_t num_cached[POOL_NUM_CLASSES];
+	pbc_pool_stats stats;
+
+	pool_cache() {
+		memset(free_list, 0, sizeof(free_list));
+		memset(num_cached, 0, sizeof(num_cached));
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	~pool_cache() {
+		pbc_pool_trim();
+	}
+};
+
+static std::atomic<bool> pool_installed(false);
+static std::atomic<bool> pool_enabled(true);
+static thread_local pool_cache cache;
+
+static int size_class(size_t size)
+{
+	int c = 0;
+	size_t class_size = POOL_MIN_SIZE;
+	while(class_size < size) {
+		class_size <<= 1;
+		c++;
+	}
+	return c;
+}
+
+static size_t *block_header(void *ptr)
+{
+	return (size_t*)((char*)ptr - POOL_HEADER_SIZE);
+}
+
+static void *pool_alloc(size_t size)
+{
+	cache.stats.alloc_calls++;
+
+	size_t capacity = size;
+	if(size <= POOL_MAX_SIZE) {
+		int c = size_class(size);
+		capacity = (size_t)POOL_MIN_SIZE << c;
+		pool_block *block = cache.free_list[c];
+		if(block != NULL && pool_enabled.load(std::memory_order_relaxed)) {
+			cache.free_list[c] = block->next;
+			cache.num_cached[c]--;
+			cache.stats.cached_bytes -= capacity;
+			return block;
+		}
+	}
+
+	cache.stats.system_allocs++;
+	size_t *header = (size_t*)malloc(POOL_HEADER_SIZE + capacity);
+	if(header == NULL) {
+		fprintf(stderr, "pbc_pool: out of memory\n");
+		abort();
+	}
+	*header = capacity;
+	return (char*)header + POOL_HEADER_SIZE;
+}
+
+static void pool_free(void *ptr)
+{
+	if(ptr == NULL)
+		return;
+	cache.stats.free_calls++;
+
+	size_t capacity = *block_header(ptr);
+	if(capacity <= POOL_MAX_SIZE && pool_enabled.load(std::memory_order_relaxed)) {
+		int c = size_class(capacity);
+		if(cache.num_cached[c] < POOL_MAX_CACHED) {
+			pool_block *block = (pool_block*)ptr;
+			block->next = cache.free_list[c];
+			cache.free_list[c] = block;
+			cache.num_cached[c]++;
+			cache.stats.cached_bytes += capacity;
+			return;
+		}
+	}
+	free(block_header(ptr));
+}
+
+static void *pool_realloc(void *ptr, size_t size)
+{
+	if(ptr == NULL)
+		return pool_alloc(size);
+
+	size_t capacity = *block_header(ptr);
+	if(size <= capacity)
+		return ptr;
+
+	void *grown = pool_alloc(size);
+	memcpy(grown, ptr, capacity);
+	pool_free(ptr);
+	return grown;
+}
+
+static void *gmp_pool_realloc(void *ptr, size_t old_size, size_t new_size)
+{
+	(void)old_size;
+	return pool_realloc(ptr, new_size);
+}
+
+static void gmp_pool_free(void *ptr, size_t size)
+{
+	(void)size;
+	pool_free(ptr);
+}
+
+void pbc_pool_install(void)
+{
+	if(pool_installed.exchange(true))
+		return;
+	mp_set_memory_functions(pool_alloc, gmp_pool_realloc, gmp_pool_free);
+	pbc_set_memory_functions(pool_alloc, pool_realloc, pool_free);
+}
+
+int pbc_pool_installed(void)
+{
+	return pool_installed.load();
+}
+
+void pbc_pool_set_enabled(int enabled)
+{
+	pool_enabled.store(enabled != 0);
+}
+
+void pbc_pool_trim(void)
+{
+	for(int c = 0; c < POOL_NUM_CLASSES; c++) {
+		pool_block *block = cache.free_list[c];
+		while(block != NULL) {
+			pool_block *next = block->next;
+			free(block_header(block));
+			block = next;
+		}
+		cache.free_list[c] = NULL;
+		cache.num_cached[c] = 0;
+	}
+	cache.stats.cached_bytes = 0;
+}
+
+void pbc_pool_get_stats(pbc_pool_stats *stats)
+{
+	*stats = cache.stats;
+}
+
+void pbc_pool_reset_stats(void)
+{
+	uint64_t cached_bytes = cache.stats.cached_bytes;
+	memset(&cache.stats, 0, sizeof(cache.stats));
+	cache.stats.cached_bytes = cached_bytes;
+}
@@ -0,0 +1,44 @@
+/*
+ * pbcpool.h
+ *
+ * Optional size-class pool for the small blocks PBC and GMP allocate
+ * inside every pairing and exponentiation. Freed blocks are kept on
+ * per-thread free lists and handed out again, so a search touches the
+ * system allocator only while the lists warm up.
+ */
+
+#ifndef PBCPOOL_H
+#define PBCPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Allocation counters of the calling thread. alloc_calls counts every
+ * allocation or growing reallocation made through the pool functions,
+ * system_allocs the ones that had to reach malloc. */
+typedef struct pbc_pool_stats_s {
+	uint64_t alloc_calls;
+	uint64_t system_allocs;
+	uint64_t free_calls;
+	uint64_t cached_bytes;
+}pbc_pool_stats;
+
+/* Route all PBC and GMP allocations through the pool. Every block gets a
+ * small header, so this must run before the first PBC or GMP allocation
+ * of the process; calling it again is a no-op. */
+void pbc_pool_install(void);
+
+int pbc_pool_installed(void);
+
+/* With pooling disabled the hooks stay in place but allocate straight
+ * from the system, which keeps the counters comparable. */
+void pbc_pool_set_enabled(int enabled);
+
+/* Return the blocks cached by the calling thread to the system */
+void pbc_pool_trim(void);
+
+void pbc_pool_get_stats(pbc_pool_stats *stats);
+
+void pbc_pool_reset_stats(void);
+
+#endif
@@ -0,0 +1,327 @@
+/*
+ * pbcwrapper.cpp
+ */
+
+#include "pbcwrapper.h"
+
+/* Pairing */
+
+Pairing::Pairing() : mParam(NULL), mPairing(NULL) {
+}
+
+Pairing::~Pairing() {
+    __clear();
+}
+
+Pairing::Pairing(Pairing &&other) : mParam(other.mParam), mPairing(other.mPairing) {
+    other.mParam = NULL;
+    other.mPairing = NULL;
+}
+
+Pairing& Pairing::operator=(Pairing &&other) {
+    if (this != &other) {
+        __clear();
+        mParam = other.mParam;
+        mPairing = other.mPairing;
+        other.mParam = NULL;
+        other.mPairing = NULL;
+    }
+    return *this;
+}
+
+void Pairing::__clear() {
+    if (mPairing != NULL) {
+        pairing_clear(mPairing);
+        pbc_param_clear(mParam);
+        delete mPairing;
+        delete mParam;
+    }
+    mParam = NULL;
+    mPairing = NULL;
+}
+
+// type A parameters when curve is NULL
+void Pairing::Generate(peks_curve *curve) {
+    __clear();
+    mParam = new pbc_param_s;
+    mPairing = new pairing_s;
+    if (curve != NULL) {
+        init_pbc_param_pairing_curve(mParam, mPairing, curve);
+    }
+    else {
+        init_pbc_param_pairing(mParam, mPairing);
+    }
+}
+
+// Same return values as init_pbc_param_pairing_file; on -1 the pairing
+// stays uninitialized.
+int Pairing::LoadOrGenerate(const std::string &param_path, bool regenerate,
+                            peks_curve *curve) {
+    __clear();
+    pbc_param_ptr param = new pbc_param_s;
+    pairing_ptr pairing = new pairing_s;
+    int err = init_pbc_param_pairing_file(param, pairing, param_path.c_str(), regenerate, curve);
+    if (err == -1) {
+        delete pairing;
+        delete param;
+        return err;
+    }
+    mParam = param;
+    mPairing = pairing;
+    return err;
+}
+
+bool Pairing::isInitialized() const {
+    return mPairing != NULL;
+}
+
+pairing_ptr Pairing::get() const {
+    return mPairing;
+}
+
+pbc_param_ptr Pairing::param() const {
+    return mParam;
+}
+
+Pairing::operator pairing_ptr() const {
+    return mPairing;
+}
+
+pairing_ptr Pairing::operator->() const {
+    return mPairing;
+}
+
+/* Element */
+
+Element::Element() {
+    mElement.field = NULL;
+    mElement.data = NULL;
+}
+
+Element::~Element() {
+    clear();
+}
+
+Element::Element(Element &&other) : mElement(other.mElement) {
+    other.mElement.field = NULL;
+    other.mElement.data = NULL;
+}
+
+Element& Element::operator=(Element &&other) {
+    if (this != &other) {
+        clear();
+        mElement = other.mElement;
+        other.mElement.field = NULL;
+        other.mElement.data = NULL;
+    }
+    return *this;
+}
+
+void Element::initG1(pairing_ptr pairing) {
+    clear();
+    element_init_G1(&mElement, pairing);
+}
+
+void Element::initG2(pairing_ptr pairing) {
+    clear();
+    element_init_G2(&mElement, pairing);
+}
+
+void Element::initGT(pairing_ptr pairing) {
+    clear();
+    element_init_GT(&mElement, pairing);
+}
+
+void Element::initZr(pairing_ptr pairing) {
+    clear();
+    element_init_Zr(&mElement, pairing);
+}
+
+void Element::initSameAs(Element &other) {
+    clear();
+    element_init_same_as(&mElement, other.get());
+}
+
+void Element::clear() {
+    if (mElement.field != NULL) {
+        element_clear(&mElement);
+    }
+    mElement.field = NULL;
+    mElement.data = NULL;
+}
+
+bool Element::isInitialized() const {
+    return mElement.field != NULL;
+}
+
+std::vector<unsigned char> Element::toBytes() {
+    std::vector<unsigned char> data(element_length_in_bytes(&mElement));
+    element_to_bytes(data.data(), &mElement);
+    return data;
+}
+
+void Element::fromBytes(const unsigned char *data) {
+    element_from_bytes(&mElement, (unsigned char*)data);
+}
+
+// only for curve points (G1, G2)
+std::vector<unsigned char> Element::toBytesCompressed() {
+    std::vector<unsigned char> data(element_length_in_bytes_compressed(&mElement));
+    element_to_bytes_compressed(data.data(), &mElement);
+    return data;
+}
+
+void Element::fromBytesCompressed(const unsigned char *data) {
+    element_from_bytes_compressed(&mElement, (unsigned char*)data);
+}
+
+element_ptr Element::get() {
+    return &mElement;
+}
+
+Element::operator element_ptr() {
+    return &mElement;
+}
+
+/* KeyPair */
+
+KeyPair::KeyPair() : mKey(NULL), mKeyPP(NULL) {
+}
+
+KeyPair::~KeyPair() {
+    __clear();
+}
+
+KeyPair::KeyPair(KeyPair &&other) : mKey(other.mKey), mKeyPP(other.mKeyPP) {
+    other.mKey = NULL;
+    other.mKeyPP = NULL;
+}
+
+KeyPair& KeyPair::operator=(KeyPair &&other) {
+    if (this != &other) {
+        __clear();
+        mKey = other.mKey;
+        mKeyPP = other.mKeyPP;
+        other.mKey = NULL;
+        other.mKeyPP = NULL;
+    }
+    return *this;
+}
+
+void KeyPair::__clear() {
+    if (mKeyPP != NULL) {
+        key_pp_clear(mKeyPP);
+        delete mKeyPP;
+    }
+    if (mKey != NULL) {
+        element_clear(mKey->priv);
+        element_clear(mKey->pub.g);
+        element_clear(mKey->pub.h);
+        delete mKey;
+    }
+    mKey = NULL;
+    mKeyPP = NULL;
+}
+
+// KeyGen and the fixed-base tables of g and h
+void KeyPair::Generate(Pairing &pairing) {
+    __clear();
+    mKey = new key;
+    KeyGen(mKey, pairing.param(), pairing);
+    Precompute();
+}
+
+// Initializes α, g and h without values, for keys read from storage;
+// call Precompute once they are set.
+void KeyPair::Init(Pairing &pairing) {
+    __clear();
+    mKey = new key;
+    element_init_Zr(mKey->priv, pairing);
+    element_init_G2(mKey->pub.g, pairing);
+    element_init_G2(mKey->pub.h, pairing);
+}
+
+void KeyPair::Precompute() {
+    if (mKeyPP != NULL) {
+        key_pp_clear(mKeyPP);
+        delete mKeyPP;
+    }
+    mKeyPP = new key_pp;
+    key_pp_init(mKeyPP, &mKey->pub);
+}
+
+bool KeyPair::isInitialized() const {
+    return mKey != NULL;
+}
+
+key *KeyPair::get() const {
+    return mKey;
+}
+
+element_ptr KeyPair::priv() const {
+    return mKey->priv;
+}
+
+key_pub *KeyPair::pub() const {
+    return &mKey->pub;
+}
+
+key_pp *KeyPair::pp() const {
+    return mKeyPP;
+}
+
+/* PeksQuery */
+
+PeksQuery::PeksQuery() : mQuery(NULL) {
+}
+
+PeksQuery::~PeksQuery() {
+    __clear();
+}
+
+PeksQuery::PeksQuery(PeksQuery &&other) : mQuery(other.mQuery) {
+    other.mQuery = NULL;
+}
+
+PeksQuery& PeksQuery::operator=(PeksQuery &&other) {
+    if (this != &other) {
+        __clear();
+        mQuery = other.mQuery;
+        other.mQuery = NULL;
+    }
+    return *this;
+}
+
+void PeksQuery::__clear() {
+    if (mQuery != NULL) {
+        peks_query_clear(mQuery);
+        delete mQuery;
+    }
+    mQuery = NULL;
+}
+
+void PeksQuery::Build(const std::string &keyword, KeyPair &key, Pairing &pairing,
+                      int hash_format) {
+    __clear();
+    mQuery = new peks_query;
+    PEKSQuery(mQuery, (char*)keyword.c_str(), (int)keyword.length(),
+              key.pub(), key.pp(), pairing, hash_format);
+}
+
+void PeksQuery::CopyFrom(PeksQuery &other, Pairing &pairing) {
+    __clear();
+    mQuery = new peks_query;
+    peks_query_copy(mQuery, other.mQuery, pairing);
+}
+
+bool PeksQuery::Test(Element &Tw, Pairing &pairing) {
+    return TestPrepared(mQuery, Tw, pairing) != 0;
+}
+
+bool PeksQuery::isInitialized() const {
+    return mQuery != NULL;
+}
+
+peks_query *PeksQuery::get() const {
+    return mQuery;
+}
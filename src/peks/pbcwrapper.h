@@ -0,0 +1,122 @@
+/*
+ * pbcwrapper.h
+ *
+ * Move-only owners for PBC objects. Each type clears what it holds when
+ * it is destroyed, so temporaries on the PEKS hot path cannot leak.
+ * Pairings, keys and queries live on the heap because PBC keeps pointers
+ * into them (elements into their pairing's fields, element_pp into its
+ * base element), which must stay valid when the owner is moved.
+ */
+
+#ifndef PBCWRAPPER_H
+#define PBCWRAPPER_H
+
+#include <string>
+#include <vector>
+
+#include "peks.h"
+
+class Pairing
+{
+public:
+    Pairing();
+    ~Pairing();
+    Pairing(Pairing &&other);
+    Pairing& operator=(Pairing &&other);
+    Pairing(const Pairing&) = delete;
+    Pairing& operator=(const Pairing&) = delete;
+
+    void Generate(peks_curve *curve = NULL);
+    int LoadOrGenerate(const std::string &param_path, bool regenerate,
+                       peks_curve *curve = NULL);
+    bool isInitialized() const;
+    pairing_ptr get() const;
+    pbc_param_ptr param() const;
+    operator pairing_ptr() const;
+    pairing_ptr operator->() const;
+
+private:
+    pbc_param_ptr mParam;
+    pairing_ptr mPairing;
+
+    void __clear();
+};
+
+class Element
+{
+public:
+    Element();
+    ~Element();
+    Element(Element &&other);
+    Element& operator=(Element &&other);
+    Element(const Element&) = delete;
+    Element& operator=(const Element&) = delete;
+
+    void initG1(pairing_ptr pairing);
+    void initG2(pairing_ptr pairing);
+    void initGT(pairing_ptr pairing);
+    void initZr(pairing_ptr pairing);
+    void initSameAs(Element &other);
+    void clear();
+    bool isInitialized() const;
+    std::vector<unsigned char> toBytes();
+    std::vector<unsigned char> toBytesCompressed();
+    void fromBytes(const unsigned char *data);
+    void fromBytesCompressed(const unsigned char *data);
+    element_ptr get();
+    operator element_ptr();
+
+private:
+    element_s mElement;
+};
+
+class KeyPair
+{
+public:
+    KeyPair();
+    ~KeyPair();
+    KeyPair(KeyPair &&other);
+    KeyPair& operator=(KeyPair &&other);
+    KeyPair(const KeyPair&) = delete;
+    KeyPair& operator=(const KeyPair&) = delete;
+
+    void Generate(Pairing &pairing);
+    void Init(Pairing &pairing);
+    void Precompute();
+    bool isInitialized() const;
+    key *get() const;
+    element_ptr priv() const;
+    key_pub *pub() const;
+    key_pp *pp() const;
+
+private:
+    key *mKey;
+    key_pp *mKeyPP;
+
+    void __clear();
+};
+
+class PeksQuery
+{
+public:
+    PeksQuery();
+    ~PeksQuery();
+    PeksQuery(PeksQuery &&other);
+    PeksQuery& operator=(PeksQuery &&other);
+    PeksQuery(const PeksQuery&) = delete;
+    PeksQuery& operator=(const PeksQuery&) = delete;
+
+    void Build(const std::string &keyword, KeyPair &key, Pairing &pairing,
+               int hash_format = PEKS_HASH_BINARY);
+    void CopyFrom(PeksQuery &other, Pairing &pairing);
+    bool Test(Element &Tw, Pairing &pairing);
+    bool isInitialized() const;
+    peks_query *get() const;
+
+private:
+    peks_query *mQuery;
+
+    void __clear();
+};
+
+#endif
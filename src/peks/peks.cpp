@@ -10,16 +10,46 @@
 void sha512(const char *word, int word_size, 
 		char hashed_word[SHA512_DIGEST_LENGTH*2+1]) 
 {
-	int i;
 	unsigned char digest[SHA512_DIGEST_LENGTH];
 
+	sha512_raw(word, word_size, digest);
+	hex_encode(digest, SHA512_DIGEST_LENGTH, hashed_word);
+}
+
+void sha512_raw(const char *word, int word_size,
+		unsigned char digest[SHA512_DIGEST_LENGTH])
+{
 	SHA512_CTX ctx;
 	SHA512_Init(&ctx);
 	SHA512_Update(&ctx, word, word_size);
 	SHA512_Final(digest, &ctx);
+}
+
+/* Lowercase hex of data into hex[2*len], NUL terminated */
+void hex_encode(const unsigned char *data, int len, char *hex)
+{
+	static const char digits[] = "0123456789abcdef";
+	int i;
 
-	for (i = 0; i < SHA512_DIGEST_LENGTH; i++)
-		sprintf(&hashed_word[i*2], "%02x", (unsigned int)digest[i]);
+	for (i = 0; i < len; i++) {
+		hex[i*2] = digits[data[i] >> 4];
+		hex[i*2+1] = digits[data[i] & 0x0f];
+	}
+	hex[len*2] = '\0';
+}
+
+/* H1(W) from the SHA-512 digest of W, see PEKS_HASH_HEX */
+void H1(element_t H1_W, pairing_t pairing,
+		const unsigned char digest[SHA512_DIGEST_LENGTH], int hash_format)
+{
+	element_init_G1(H1_W, pairing);
+	if(hash_format == PEKS_HASH_HEX) {
+		char hex[SHA512_DIGEST_LENGTH*2+1];
+		hex_encode(digest, SHA512_DIGEST_LENGTH, hex);
+		element_from_hash(H1_W, hex, SHA512_DIGEST_LENGTH*2);
+	}
+	else
+		element_from_hash(H1_W, (void*)digest, SHA512_DIGEST_LENGTH);
 }
 
 void get_n_bits(char* src, char* out, int bitswanted)
@@ -38,6 +68,28 @@ void get_n_bits(char* src, char* out, int bitswanted)
 	}
 }
 
+void H2_tag(const unsigned char digest[SHA512_DIGEST_LENGTH], int bitswanted,
+		uint64_t tag[PEKS_TAG_MAX_WORDS])
+{
+	int nbytes = (bitswanted + 7) / 8;
+	unsigned char *bytes = (unsigned char*)tag;
+
+	memset(tag, 0, sizeof(uint64_t)*PEKS_TAG_MAX_WORDS);
+	memcpy(bytes, digest, nbytes);
+	if(bitswanted % 8)
+		bytes[nbytes-1] &= (unsigned char)(0xff << (8 - bitswanted % 8));
+}
+
+int peks_tag_equal(const uint64_t *a, const uint64_t *b, int bits)
+{
+	uint64_t diff = 0;
+	int i;
+
+	for(i = 0; i < PEKS_TAG_WORDS(bits); i++)
+		diff |= a[i] ^ b[i];
+	return diff == 0;
+}
+
 void key_printf(key key)
 {
 	element_printf("α %B\n", key.priv);
@@ -47,22 +99,178 @@ void key_printf(key key)
 
 void peks_printf(peks peks)
 {
+	int i;
+
 	element_printf("A %B\n", peks.A);
-	printf("B %s\n", peks.B);
+	printf("B ");
+	for(i = 0; i < PEKS_TAG_MAX_WORDS; i++)
+		printf("%016llx", (unsigned long long)peks.B[i]);
+	printf("\n");
+}
+
+/* Curve by its name in the agent config ("A", "A1", "E" or "F"), with
+ * the sizes of that family when rbits or qbits is 0. Returns -1 for an
+ * unknown name. */
+int peks_curve_init(peks_curve *curve, const char *name, int rbits, int qbits)
+{
+	if(!strcmp(name, "A") || !strcmp(name, "a")) {
+		curve->type = 'a';
+		curve->rbits = 160;
+		curve->qbits = 512;
+	}
+	else if(!strcmp(name, "A1") || !strcmp(name, "a1")) {
+		curve->type = 'A';
+		curve->rbits = 512;
+		curve->qbits = 0;
+	}
+	else if(!strcmp(name, "E") || !strcmp(name, "e")) {
+		curve->type = 'e';
+		curve->rbits = 160;
+		curve->qbits = 1024;
+	}
+	else if(!strcmp(name, "F") || !strcmp(name, "f")) {
+		curve->type = 'f';
+		curve->rbits = 160;
+		curve->qbits = 0;
+	}
+	else
+		return -1;
+
+	if(rbits > 0)
+		curve->rbits = rbits;
+	if(qbits > 0 && curve->qbits > 0)
+		curve->qbits = qbits;
+	return 0;
+}
+
+const char *peks_curve_name(peks_curve *curve)
+{
+	switch(curve->type) {
+	case 'a': return "A";
+	case 'A': return "A1";
+	case 'e': return "E";
+	case 'f': return "F";
+	}
+	return "?";
 }
 
 void init_pbc_param_pairing(pbc_param_t param, pairing_t pairing)
 {
-	int rbits = 160;
-	int qbits = 512;
+	peks_curve curve;
+
+	/* Type A pairing parameters, rbits = 160 and qbits = 512 */
+	peks_curve_init(&curve, "A", 0, 0);
+	init_pbc_param_pairing_curve(param, pairing, &curve);
+}
 
-	/* Generate type A pairing parameters */
-	pbc_param_init_a_gen(param, rbits, qbits);
+void init_pbc_param_pairing_curve(pbc_param_t param, pairing_t pairing,
+		peks_curve *curve)
+{
+	mpz_t p, q, n;
+
+	/* Generate pairing parameters of the curve family */
+	switch(curve->type) {
+	case 'A':
+		/* group order n = pq */
+		mpz_init(p);
+		mpz_init(q);
+		mpz_init(n);
+		pbc_mpz_randomb(p, curve->rbits);
+		mpz_setbit(p, curve->rbits - 1);
+		mpz_nextprime(p, p);
+		do {
+			pbc_mpz_randomb(q, curve->rbits);
+			mpz_setbit(q, curve->rbits - 1);
+			mpz_nextprime(q, q);
+		} while(!mpz_cmp(p, q));
+		mpz_mul(n, p, q);
+		pbc_param_init_a1_gen(param, n);
+		mpz_clear(p);
+		mpz_clear(q);
+		mpz_clear(n);
+		break;
+	case 'e':
+		pbc_param_init_e_gen(param, curve->rbits, curve->qbits);
+		break;
+	case 'f':
+		pbc_param_init_f_gen(param, curve->rbits);
+		break;
+	default:
+		pbc_param_init_a_gen(param, curve->rbits, curve->qbits);
+		break;
+	}
 
 	/* Initialize pairing */
 	pairing_init_pbc_param(pairing, param);
 }
 
+/* Load the pairing parameters stored at param_path, or generate and
+ * store them if the file does not exist yet or regenerate is set. New
+ * parameters are made on curve, or type A if it is NULL; stored ones
+ * keep the curve they were made on.
+ * Returns 0 on success, -1 if the stored file cannot be parsed and -2
+ * if freshly generated parameters (still usable) could not be stored. */
+int init_pbc_param_pairing_file(pbc_param_t param, pairing_t pairing,
+		const char *param_path, int regenerate, peks_curve *curve)
+{
+	FILE *fp = NULL;
+
+	if(!regenerate && (fp = fopen(param_path, "rb")) != NULL) {
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		rewind(fp);
+
+		char *buffer = (char*) malloc(sizeof(char)*(size+1));
+		size_t len = fread(buffer, 1, size, fp);
+		buffer[len] = '\0';
+		fclose(fp);
+
+		int err = pbc_param_init_set_buf(param, buffer, len);
+		free(buffer); buffer = NULL;
+		if(err)
+			return -1;
+
+		pairing_init_pbc_param(pairing, param);
+		return 0;
+	}
+
+	if(curve)
+		init_pbc_param_pairing_curve(param, pairing, curve);
+	else
+		init_pbc_param_pairing(param, pairing);
+
+	/* Write to a temporary file first so a crash never leaves a
+	 * truncated parameter file behind */
+	size_t tmp_len = strlen(param_path) + 5;
+	char *tmp_path = (char*) malloc(sizeof(char)*tmp_len);
+	snprintf(tmp_path, tmp_len, "%s.tmp", param_path);
+
+	int err = -2;
+	if((fp = fopen(tmp_path, "wb")) != NULL) {
+		pbc_param_out_str(fp, param);
+		if(!fclose(fp) && !rename(tmp_path, param_path))
+			err = 0;
+	}
+
+	free(tmp_path); tmp_path = NULL;
+	return err;
+}
+
+/* SHA-256 of the textual form of the pairing parameters, used to tie
+ * stored keys and trapdoors to the curve they were made on */
+void pbc_param_hash(pbc_param_t param,
+		unsigned char digest[SHA256_DIGEST_LENGTH])
+{
+	char *buffer = NULL;
+	size_t len = 0;
+	FILE *fp = open_memstream(&buffer, &len);
+	pbc_param_out_str(fp, param);
+	fclose(fp);
+
+	SHA256((unsigned char*)buffer, len, digest);
+	free(buffer); buffer = NULL;
+}
+
 void KeyGen(key *key, pbc_param_t param, pairing_t pairing)
 {
 	/* Private key - α */
@@ -70,41 +278,85 @@ void KeyGen(key *key, pbc_param_t param, pairing_t pairing)
 	element_random(key->priv);
 
 	/* Public key - Apub = [g, h=g^α] */
-	element_init_G1(key->pub.g, pairing);
+	element_init_G2(key->pub.g, pairing);
 	element_random(key->pub.g);
-	element_init_G1(key->pub.h, pairing);
+	element_init_G2(key->pub.h, pairing);
 	element_pow_zn(key->pub.h, key->pub.g, key->priv);
 }
 
+void key_pp_init(key_pp *pp, key_pub *pub)
+{
+	element_pp_init(pp->g, pub->g);
+	element_pp_init(pp->h, pub->h);
+}
+
+void key_pp_clear(key_pp *pp)
+{
+	element_pp_clear(pp->g);
+	element_pp_clear(pp->h);
+}
+
+static void PEKS_H2(peks *peks, pairing_t pairing, element_t H1_W,
+		element_t hR, int bitswanted)
+{
+	element_t t;
+
+	/* t = hasedW1 X hR */
+	element_init_GT(t, pairing);
+	pairing_apply(t, H1_W, hR, pairing);
+
+	/* H2(t) over the bytes of t */
+	int len_t = element_length_in_bytes(t);
+	unsigned char *bytes_t = (unsigned char*) malloc(sizeof(unsigned char)*len_t);
+	unsigned char digest[SHA512_DIGEST_LENGTH];
+	element_to_bytes(bytes_t, t);
+	sha512_raw((char*)bytes_t, len_t, digest);
+	H2_tag(digest, bitswanted, peks->B);
+
+	element_clear(t);
+	free(bytes_t); bytes_t = NULL;
+}
+
 void PEKS(peks *peks, key_pub *pub, pairing_t pairing,
 		element_t H1_W, int bitswanted)
 {
-	char *H2_t = peks->B;
-	element_t r, hR, t;
+	element_t r, hR;
 
 	/* hR = h^r */
 	element_init_Zr(r ,pairing);
 	element_random(r);
-	element_init_G1(hR, pairing);
+	element_init_G2(hR, pairing);
 	element_pow_zn(hR, pub->h, r);
 
-	/* t = hasedW1 X hR */
-	element_init_GT(t, pairing);
-	pairing_apply(t, H1_W, hR, pairing);
-
 	/* gR = g^r */
-	element_init_G1(peks->A, pairing);
+	element_init_G2(peks->A, pairing);
 	element_pow_zn(peks->A, pub->g, r);
 
-	/* H2(t) */
-    char *char_t = (char*) malloc(sizeof(char)*element_length_in_bytes(t));
-    char *buffer = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-	element_snprint(char_t, element_length_in_bytes(t), t);
-	sha512(char_t, element_length_in_bytes(t), buffer);
-	get_n_bits(buffer, H2_t, bitswanted);
+	PEKS_H2(peks, pairing, H1_W, hR, bitswanted);
 
-	free(char_t); char_t = NULL;
-	free(buffer); buffer = NULL;
+	element_clear(r);
+	element_clear(hR);
+}
+
+void PEKS_pp(peks *peks, key_pp *pp, pairing_t pairing,
+		element_t H1_W, int bitswanted)
+{
+	element_t r, hR;
+
+	/* hR = h^r from the fixed-base table of h */
+	element_init_Zr(r ,pairing);
+	element_random(r);
+	element_init_G2(hR, pairing);
+	element_pp_pow_zn(hR, r, pp->h);
+
+	/* gR = g^r from the fixed-base table of g */
+	element_init_G2(peks->A, pairing);
+	element_pp_pow_zn(peks->A, r, pp->g);
+
+	PEKS_H2(peks, pairing, H1_W, hR, bitswanted);
+
+	element_clear(r);
+	element_clear(hR);
 }
 
 void Trapdoor(element_t Tw, pairing_t pairing, element_t alpha,
@@ -115,57 +367,106 @@ void Trapdoor(element_t Tw, pairing_t pairing, element_t alpha,
 	element_pow_zn(Tw, H1_W, alpha);
 }
 
-int Test(char *W2, int lenW2, key_pub *pub, element_t Tw, pairing_t pairing)
+int Test(char *W2, int lenW2, key_pub *pub, element_t Tw, pairing_t pairing,
+		int hash_format)
 {
 	/* PEKS for W2S */
+	peks_query query;
+	PEKSQuery(&query, W2, lenW2, pub, NULL, pairing, hash_format);
 
+	int match = TestPrepared(&query, Tw, pairing);
+
+	peks_query_clear(&query);
+	return match;
+}
+
+void PEKSQuery(peks_query *query, char *W2, int lenW2, key_pub *pub,
+		key_pp *pp, pairing_t pairing, int hash_format)
+{
 	/* PEKS = [A, B] i.e. A=g^r and B=H2(t) */
 	peks peks;
-	
+
 	element_t H1_W2;
-	element_t temp;
 
 	double P = mpz_get_d(pairing->r);
 
-	int nlogP = log2(P);
+	/* B takes its bits from one SHA-512 digest */
+	query->nlogP = log2(P);
+	if(query->nlogP > SHA512_DIGEST_LENGTH*8)
+		query->nlogP = SHA512_DIGEST_LENGTH*8;
 
 	/* H1(W2S) */
-    char *hashedW2 = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-	sha512(W2, lenW2, hashedW2);
-	element_init_G1(H1_W2, pairing);
-	element_from_hash(H1_W2, hashedW2, strlen(hashedW2));
-
+	unsigned char digestW2[SHA512_DIGEST_LENGTH];
+	sha512_raw(W2, lenW2, digestW2);
+	H1(H1_W2, pairing, digestW2, hash_format);
 
 	/* PEKS(key_pub, W2) */
-    peks.B = (char*) malloc(sizeof(char)*(nlogP));
-	PEKS(&peks, pub, pairing, H1_W2, nlogP);
+	if(pp)
+		PEKS_pp(&peks, pp, pairing, H1_W2, query->nlogP);
+	else
+		PEKS(&peks, pub, pairing, H1_W2, query->nlogP);
+
+	/* The query owns A and B from here on */
+	query->A[0] = peks.A[0];
+	memcpy(query->B, peks.B, sizeof(query->B));
+
+	/* A is the fixed argument of every pairing in the search */
+	query->use_pp = pairing_is_symmetric(pairing);
+	if(query->use_pp)
+		pairing_pp_init(query->pp, query->A, pairing);
+	element_init_GT(query->temp, pairing);
+	query->scratch_len = element_length_in_bytes(query->temp);
+	query->scratch = (char*) malloc(sizeof(char)*query->scratch_len);
+
+	element_clear(H1_W2);
+}
 
-	element_init_GT(temp, pairing);
-	pairing_apply(temp, Tw, peks.A, pairing);
+int TestPrepared(peks_query *query, element_t Tw, pairing_t pairing)
+{
+	element_ptr temp = query->temp;
+	int nlogP = query->nlogP;
+
+	/* e(Tw, A), which is e(A, Tw) from the preprocessed A when the
+	 * pairing is symmetric */
+	if(query->use_pp)
+		pairing_pp_apply(temp, Tw, query->pp);
+	else
+		pairing_apply(temp, Tw, query->A, pairing);
+
+	/* H2(temp) over the bytes of temp, in the scratch buffers of the query */
+	unsigned char *bytes_temp = (unsigned char*)query->scratch;
+	unsigned char digest[SHA512_DIGEST_LENGTH];
+	element_to_bytes(bytes_temp, temp);
+	sha512_raw((char*)bytes_temp, query->scratch_len, digest);
+	H2_tag(digest, nlogP, query->H2);
 
-	/* H2(temp) */
-    char *char_temp = (char*) malloc(sizeof(char)*element_length_in_bytes(temp));
-    char *hashed_temp = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-	element_snprint(char_temp, element_length_in_bytes(temp), temp);
-	sha512(char_temp, element_length_in_bytes(temp), hashed_temp);
-    char *H2_lhs = (char*) malloc(sizeof(char)*(nlogP));
-	get_n_bits(hashed_temp, H2_lhs, nlogP);
+	return peks_tag_equal(query->H2, query->B, nlogP);
+}
 
+void peks_query_copy(peks_query *dst, peks_query *src, pairing_t pairing)
+{
+	dst->nlogP = src->nlogP;
 
-	int match;
-	if(!memcmp(H2_lhs, peks.B, nlogP))
-		match = 1;
-	else 
-		match = 0;
-
-	/* Free the memory */
-	free(H2_lhs); H2_lhs = NULL;
-	free(peks.B); peks.B = NULL;
-	free(char_temp); char_temp = NULL;
-	free(hashed_temp); hashed_temp = NULL;
-	free(hashedW2); hashedW2 = NULL;
+	element_init_same_as(dst->A, src->A);
+	element_set(dst->A, src->A);
 
-	return match;
+	memcpy(dst->B, src->B, sizeof(dst->B));
+
+	dst->use_pp = src->use_pp;
+	if(dst->use_pp)
+		pairing_pp_init(dst->pp, dst->A, pairing);
+	element_init_GT(dst->temp, pairing);
+	dst->scratch_len = src->scratch_len;
+	dst->scratch = (char*) malloc(sizeof(char)*dst->scratch_len);
+}
+
+void peks_query_clear(peks_query *query)
+{
+	element_clear(query->temp);
+	if(query->use_pp)
+		pairing_pp_clear(query->pp);
+	element_clear(query->A);
+	free(query->scratch); query->scratch = NULL;
 }
 
 int peks_scheme(char* W1, char *W2)
@@ -199,20 +500,23 @@ int peks_scheme(char* W1, char *W2)
 
 
 	/* H1(W) */
-    char *hashedW = (char*) malloc(sizeof(char)*SHA512_DIGEST_LENGTH*2+1);
-	sha512(W1, (int)strlen(W1), hashedW);
-	element_init_G1(H1_W1, pairing);
-	element_from_hash(H1_W1, hashedW, (int)strlen(hashedW));
+	unsigned char digestW[SHA512_DIGEST_LENGTH];
+	sha512_raw(W1, (int)strlen(W1), digestW);
+	H1(H1_W1, pairing, digestW, PEKS_HASH_BINARY);
 
 
 	/* Trapdoor */
 	Trapdoor(Tw, pairing, key.priv, H1_W1);
 
 	int match;
-	match =	Test(W2, (int)strlen(W2), &key.pub, Tw, pairing);
-
-	free(hashedW); hashedW = NULL;
-	//free(peks.B); peks.B = NULL;
+	match =	Test(W2, (int)strlen(W2), &key.pub, Tw, pairing, PEKS_HASH_BINARY);
+
+	element_clear(Tw);
+	element_clear(H1_W1);
+	element_clear(key.priv);
+	element_clear(key.pub.g);
+	element_clear(key.pub.h);
+	pairing_clear(pairing);
 	pbc_param_clear(param);
 	return match;
 }
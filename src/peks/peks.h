@@ -5,6 +5,9 @@
  *      Author: mahind
  */
 
+#ifndef PEKS_H
+#define PEKS_H
+
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
@@ -13,11 +16,35 @@
 #include <gmp.h>
 #include <pbc/pbc.h>
 #include <assert.h>
+#include <stdint.h>
 #include <openssl/sha.h>
 
 //#define DEBUG 1
 
-/* Apriv = α and Apub  = [g, h=g^α] */
+/* How a word is hashed into G1 by H1. Trapdoors only match queries
+ * hashed the same way, so stored trapdoors carry the format they were
+ * made with. PEKS_HASH_HEX feeds the hex text of the SHA-512 digest to
+ * element_from_hash as the original scheme did, PEKS_HASH_BINARY the
+ * raw 64-byte digest. H2 is only evaluated within one search and always
+ * hashes the raw bytes of the GT element. */
+#define PEKS_HASH_HEX 0
+#define PEKS_HASH_BINARY 1
+
+/* Curve family and sizes of freshly generated pairing parameters. type
+ * is 'a' (type A, supersingular), 'A' (type A1, composite order), 'e'
+ * (type E) or 'f' (type F, Barreto-Naehrig). Types A, A1 and E are
+ * symmetric, F is asymmetric. rbits is the size of the group order, for
+ * A1 of each of its two prime factors, qbits the size of the base field
+ * of types A and E. */
+typedef struct peks_curve_s {
+	char type;
+	int rbits;
+	int qbits;
+}peks_curve;
+
+/* Apriv = α and Apub  = [g, h=g^α]. g and h live in G2 and words are
+ * hashed into G1, so the scheme also runs on asymmetric curves; on
+ * symmetric ones G1 and G2 are the same group. */
 typedef struct key_pub_s {
 	element_t g;
 	element_t h;
@@ -27,32 +54,108 @@ typedef struct key_s {
 	key_pub pub;
 }key;
 
+/* Fixed-base exponentiation tables for g and h of one Apub */
+typedef struct key_pp_s {
+	element_pp_t g;
+	element_pp_t h;
+}key_pp;
+
+/* H2 tags are the first nlogP bits of a SHA-512 digest, packed into
+ * 64-bit words in digest order with the unused bits cleared, so two tags
+ * compare with a few word operations */
+#define PEKS_TAG_MAX_WORDS (SHA512_DIGEST_LENGTH/8)
+#define PEKS_TAG_WORDS(bits) (((bits)+63)/64)
+
 /* PEKS = [A, B] i.e. A=g^r and B=H2(t) */
 typedef struct peks_s {
 	element_t A;
-	char* B;
+	uint64_t B[PEKS_TAG_MAX_WORDS];
 }peks;
 
+/* Query-side PEKS of one keyword, built once per search and tested
+ * against every stored trapdoor. nlogP is the width of B in bits, pp
+ * holds the precomputed Miller loop of A for e(Tw, A) when use_pp is
+ * set (PBC only preprocesses the first argument of a pairing, so only
+ * symmetric pairings can use it for A), and temp, scratch
+ * (the bytes of temp) and H2 are what TestPrepared reuses for every
+ * trapdoor, so one query must not be tested from two threads at once;
+ * give every thread its own peks_query_copy. */
+typedef struct peks_query_s {
+	element_t A;
+	uint64_t B[PEKS_TAG_MAX_WORDS];
+	int nlogP;
+	int use_pp;
+	pairing_pp_t pp;
+	element_t temp;
+	char* scratch;
+	int scratch_len;
+	uint64_t H2[PEKS_TAG_MAX_WORDS];
+}peks_query;
+
 void sha512(const char *word, int word_size, 
 		char hashed_word[SHA512_DIGEST_LENGTH*2+1]);
 
+void sha512_raw(const char *word, int word_size,
+		unsigned char digest[SHA512_DIGEST_LENGTH]);
+
+void hex_encode(const unsigned char *data, int len, char *hex);
+
+void H1(element_t H1_W, pairing_t pairing,
+		const unsigned char digest[SHA512_DIGEST_LENGTH], int hash_format);
+
 void get_n_bits(char* src, char* out, int bitswanted);
 
+void H2_tag(const unsigned char digest[SHA512_DIGEST_LENGTH], int bitswanted,
+		uint64_t tag[PEKS_TAG_MAX_WORDS]);
+
+int peks_tag_equal(const uint64_t *a, const uint64_t *b, int bits);
+
 void key_printf(key key);
 
 void peks_printf(peks peks);
 
+int peks_curve_init(peks_curve *curve, const char *name, int rbits, int qbits);
+
+const char *peks_curve_name(peks_curve *curve);
+
 void init_pbc_param_pairing(pbc_param_t param, pairing_t pairing);
 
+void init_pbc_param_pairing_curve(pbc_param_t param, pairing_t pairing,
+		peks_curve *curve);
+
+int init_pbc_param_pairing_file(pbc_param_t param, pairing_t pairing,
+		const char *param_path, int regenerate, peks_curve *curve);
+
+void pbc_param_hash(pbc_param_t param,
+		unsigned char digest[SHA256_DIGEST_LENGTH]);
+
 void KeyGen(key *key, pbc_param_t param, pairing_t pairing);
 
+void key_pp_init(key_pp *pp, key_pub *pub);
+
+void key_pp_clear(key_pp *pp);
+
 void PEKS(peks *peks, key_pub *pub, pairing_t pairing,
 		element_t H1_W, int bitswanted);
 
+void PEKS_pp(peks *peks, key_pp *pp, pairing_t pairing,
+		element_t H1_W, int bitswanted);
+
 void Trapdoor(element_t Tw, pairing_t pairing, element_t alpha,
 		element_t H1_W);
 
-int Test(char *W2S, int lenW2S, key_pub *pub, element_t Tw, pairing_t pairing);
+int Test(char *W2S, int lenW2S, key_pub *pub, element_t Tw, pairing_t pairing,
+		int hash_format);
+
+void PEKSQuery(peks_query *query, char *W2, int lenW2, key_pub *pub,
+		key_pp *pp, pairing_t pairing, int hash_format);
+
+int TestPrepared(peks_query *query, element_t Tw, pairing_t pairing);
+
+void peks_query_copy(peks_query *dst, peks_query *src, pairing_t pairing);
+
+void peks_query_clear(peks_query *query);
 
 int peks_scheme(char* W1, char *W2);
 
+#endif
@@ -1,9 +1,11 @@
 #include "seller.h"
 
 Seller::Seller () {
+    mHttpThreads = 1;
 }
 
 Seller::Seller(string seller_info_filepath) {
+    mHttpThreads = 1;
     Load_Seller_Info(seller_info_filepath);
 }
 
@@ -16,6 +18,10 @@ void Seller::Load_Seller_Info(string Seller_info_filepath) {
         mAddr = seller_map["ADDR"];
         mIPAddr = seller_map["IP_ADDR"];
         mOpenPort = seller_map["OPENPORT"];
+        // a quote is a map lookup, so there is no compute pool to size
+        if (seller_map["HTTP_THREADS"] != "") {
+            mHttpThreads = max(1UL, stoul(seller_map["HTTP_THREADS"]));
+        }
         mProductMap.empty();
 
         string products = seller_map["PRODUCTS"];
@@ -70,13 +76,16 @@ string Seller::getOpenPort() {
     return this->mOpenPort;
 }
 
+// does not insert unknown products, so the I/O threads can quote at once
 double Seller::getPrice(string product) {
-    return this->mProductMap[product];
+    map<string, double>::iterator it = this->mProductMap.find(product);
+    return it != this->mProductMap.end() ? it->second : 0;
 }
 
 void Seller::waitforTransaction() {
     HttpServer server;
     server.config.port = stoi(mOpenPort);
+    server.config.thread_pool_size = mHttpThreads;
     cout << "Waiting for transaction......" << endl;
     server.resource["^/purchase$"]["POST"] = [this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) {
         try {
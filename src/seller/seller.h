@@ -40,6 +40,7 @@ private:
     string mAddr;
     string mIPAddr;
     string mOpenPort;
+    size_t mHttpThreads;
     vector<string> mProductList;
     map<string, double> mProductMap;
 
@@ -2,12 +2,30 @@
 
 int main(int argc, char** argv) {
 
-    if(argc < 2) {
-        cout<< "usage: test_supervisor keyword" << endl;
+    // at most limit transactions of a keyword, 0 for all of them
+    uint64_t limit = 0;
+    int arg = 1;
+    if(argc > 2 && string(argv[1]) == "--limit") {
+        limit = strtoull(argv[2], NULL, 10);
+        arg = 3;
+    }
+
+    if(argc - arg < 1 || argc - arg > 2) {
+        cout<< "usage: test_supervisor [--limit N] keyword [field]" << endl;
+        cout<< "       test_supervisor --query \"buyer=0x111 AND drug\"" << endl;
         return 0;
     }
 
     Supervisor supervisor = Supervisor("../supervisor_storage/agent_info");
-    supervisor.SearchKeyword(argv[1]);
+    if(string(argv[arg]) == "--query") {
+        if(argc - arg < 2) {
+            cout<< "usage: test_supervisor --query query" << endl;
+            return 0;
+        }
+        supervisor.SearchQuery(argv[arg + 1]);
+    }
+    else {
+        supervisor.SearchKeyword(argv[arg], argc - arg > 1 ? argv[arg + 1] : "", limit);
+    }
     return 0;
 }
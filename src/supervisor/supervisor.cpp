@@ -20,12 +20,39 @@ void Supervisor::Load_Agent_Info(string agent_info_path) {
     }
 }
 
-void Supervisor::SearchKeyword(string keyword) {
-    HttpClient requestsearch_client(mAgent.getIPAddr() + ":" + mAgent.getOpenPort());
-
-    string request_json_str = "{\"keyword\": \"" + keyword + "\"}";
+// field restricts the search to one contract field (buyer, seller,
+// product, price, description or txid), every field when empty; with a
+// limit the agent stops scanning once it found that many transactions
+void Supervisor::SearchKeyword(string keyword, string field, uint64_t limit) {
+    string request_json_str = "{\"keyword\": \"" + keyword + "\"";
+    if (field != "") {
+        request_json_str += ", \"field\": \"" + field + "\"";
+    }
+    if (limit > 0) {
+        request_json_str += ", \"limit\": " + to_string(limit);
+    }
+    request_json_str += "}";
 
     cout << "sending requst to search keyword " << keyword << endl;
+    __send_searchrequest(request_json_str);
+}
+
+// query combines keywords with AND, OR, NOT and parentheses, terms may be
+// scoped as field=keyword and quoted as "keyword"
+void Supervisor::SearchQuery(string query) {
+    // written by the JSON writer, which escapes the quotes of the query
+    ptree pt;
+    pt.put("query", query);
+    stringstream request_json;
+    write_json(request_json, pt, false);
+    string request_json_str = request_json.str();
+
+    cout << "sending requst to search query " << query << endl;
+    __send_searchrequest(request_json_str);
+}
+
+void Supervisor::__send_searchrequest(string request_json_str) {
+    HttpClient requestsearch_client(mAgent.getIPAddr() + ":" + mAgent.getOpenPort());
 
     // send to the seller, waiting for the price
     requestsearch_client.request("POST", "/searchrequest", request_json_str, [](shared_ptr<HttpClient::Response> response, const SimpleWeb::error_code &ec) {
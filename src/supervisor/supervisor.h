@@ -21,10 +21,13 @@ class Supervisor
 public:
     Supervisor(string agent_info_path);
     void Load_Agent_Info(string agent_info_path);
-    void SearchKeyword(string keyword);
+    void SearchKeyword(string keyword, string field = "", uint64_t limit = 0);
+    void SearchQuery(string query);
 
 private:
     Agent mAgent;
+
+    void __send_searchrequest(string request_json_str);
 };
 
 #endif
@@ -0,0 +1,141 @@
+#include "threadpool.h"
+
+// index of the pool worker running on this thread, if any
+static thread_local ThreadPool *tCurrentPool = NULL;
+static thread_local size_t tCurrentWorker = 0;
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    mPending = 0;
+    mStop = false;
+    mNextWorker = 0;
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        mWorkers.push_back(unique_ptr<Worker>(new Worker()));
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        mThreads.push_back(thread(&ThreadPool::__run, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        unique_lock<mutex> lock(mIdleMutex);
+        mStop = true;
+    }
+    mIdleCond.notify_all();
+    for (size_t i = 0; i < mThreads.size(); i++) {
+        mThreads[i].join();
+    }
+}
+
+size_t ThreadPool::getNumThreads() {
+    return mWorkers.size();
+}
+
+void ThreadPool::__push(size_t worker, Task task) {
+    {
+        unique_lock<mutex> lock(mWorkers[worker]->mMutex);
+        mWorkers[worker]->mTasks.push_back(task);
+    }
+    {
+        unique_lock<mutex> lock(mIdleMutex);
+        mPending++;
+    }
+    mIdleCond.notify_one();
+}
+
+void ThreadPool::Submit(Task task) {
+    // tasks spawned by a worker stay local, the rest are spread out
+    size_t worker;
+    if (tCurrentPool == this) {
+        worker = tCurrentWorker;
+    }
+    else {
+        worker = mNextWorker++ % mWorkers.size();
+    }
+    __push(worker, task);
+}
+
+bool ThreadPool::__pop(size_t worker, Task &task) {
+    {
+        Worker &own = *mWorkers[worker];
+        unique_lock<mutex> lock(own.mMutex);
+        if (!own.mTasks.empty()) {
+            task = own.mTasks.back();
+            own.mTasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < mWorkers.size(); i++) {
+        Worker &victim = *mWorkers[(worker + i) % mWorkers.size()];
+        unique_lock<mutex> lock(victim.mMutex);
+        if (!victim.mTasks.empty()) {
+            task = victim.mTasks.front();
+            victim.mTasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::__run(size_t worker) {
+    tCurrentPool = this;
+    tCurrentWorker = worker;
+    while (true) {
+        {
+            unique_lock<mutex> lock(mIdleMutex);
+            while (mPending == 0 && !mStop) {
+                mIdleCond.wait(lock);
+            }
+            if (mPending == 0 && mStop) {
+                return;
+            }
+            // claim one task; it is in some deque and nobody else can take it
+            // without claiming it as well
+            mPending--;
+        }
+        Task task;
+        while (!__pop(worker, task)) {
+            this_thread::yield();
+        }
+        task(worker);
+    }
+}
+
+void ThreadPool::ParallelFor(uint64_t begin, uint64_t end, uint64_t grain,
+                             function<void(size_t, uint64_t, uint64_t)> fn) {
+    if (begin >= end) {
+        return;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    struct State {
+        mutex mMutex;
+        condition_variable mCond;
+        uint64_t mRemaining;
+    };
+    shared_ptr<State> state = make_shared<State>();
+    state->mRemaining = (end - begin + grain - 1) / grain;
+
+    // deal the chunks out round-robin, idle workers steal the rest
+    size_t chunk = 0;
+    for (uint64_t lo = begin; lo < end; lo += grain, chunk++) {
+        uint64_t hi = min(end, lo + grain);
+        __push(chunk % mWorkers.size(), [state, fn, lo, hi](size_t worker) {
+            fn(worker, lo, hi);
+            unique_lock<mutex> lock(state->mMutex);
+            if (--state->mRemaining == 0) {
+                state->mCond.notify_all();
+            }
+        });
+    }
+
+    unique_lock<mutex> lock(state->mMutex);
+    while (state->mRemaining > 0) {
+        state->mCond.wait(lock);
+    }
+}
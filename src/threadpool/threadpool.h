@@ -0,0 +1,54 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+// Work-stealing thread pool. Every worker owns a deque of tasks; it pops
+// from the back of its own deque and, when that is empty, steals from the
+// front of the others. Tasks receive the index of the worker running them,
+// so callers can keep per-worker scratch state that is never shared.
+class ThreadPool
+{
+public:
+    typedef function<void(size_t)> Task;
+
+    ThreadPool(size_t num_threads);
+    ~ThreadPool();
+    size_t getNumThreads();
+    void Submit(Task task);
+    // Runs fn(worker, lo, hi) over [begin, end) in chunks of at most grain
+    // items and returns once all chunks are done. Must not be called from
+    // a worker of the same pool.
+    void ParallelFor(uint64_t begin, uint64_t end, uint64_t grain,
+                     function<void(size_t, uint64_t, uint64_t)> fn);
+
+private:
+    struct Worker {
+        mutex mMutex;
+        deque<Task> mTasks;
+    };
+
+    vector<unique_ptr<Worker>> mWorkers;
+    vector<thread> mThreads;
+    mutex mIdleMutex;
+    condition_variable mIdleCond;
+    uint64_t mPending;
+    bool mStop;
+    atomic<size_t> mNextWorker;
+
+    void __push(size_t worker, Task task);
+    bool __pop(size_t worker, Task &task);
+    void __run(size_t worker);
+};
+
+#endif